@@ -0,0 +1,297 @@
+// Headless benchmark of the GDResonance pipeline. Renders scripted sources
+// through ResonanceWorld exactly as the audio effect does, without Godot, and
+// reports the cost of every Render() call.
+//
+//   scons bench
+//   bench/bin/resonance_bench --sources 64 --seconds 30 --output bench.wav
+//   bench/bin/resonance_bench --groups 4 --regroup 1   # rebuild while removing sources
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platforms/common/room_properties.h"
+
+#include "resonance_world.h"
+#include "wav_file.h"
+
+namespace {
+
+// The world renders interleaved stereo.
+const size_t kNumOutputChannels = 2;
+
+// Allocations are only counted on the thread that renders, and only while it
+// is inside Render(); the builder and streamer threads allocate freely.
+thread_local bool count_allocations = false;
+std::atomic<uint64_t> num_allocations(0);
+std::atomic<uint64_t> allocated_bytes(0);
+
+void* Allocate(std::size_t size) {
+  if (count_allocations) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+struct Options {
+  int num_sources = 32;
+  double seconds = 10.0;
+  int sample_rate = 48000;
+  int frames_per_buffer = 512;
+  // Rendering mode of all sources, or ResonanceWorld::kRenderingModeAuto.
+  int rendering_mode = vraudio::kBinauralHighQuality;
+  int max_voices = ResonanceWorld::kDefaultMaxVoices;
+  int render_groups = 1;
+  // Render groups of the graph rebuilt halfway through, while half of the
+  // sources are removed, or 0 to keep the first graph.
+  int regroup = 0;
+  // DistanceModel of all sources.
+  int distance_model = kDistanceModelNone;
+  bool room = false;
+  std::string output;
+};
+
+void PrintUsage(const char* program) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --sources N        sound objects to render (32)\n"
+      "  --seconds S        duration of the render (10)\n"
+      "  --sample-rate R    sample rate of the graph (48000)\n"
+      "  --frames F         frames per Render() call (512)\n"
+      "  --mode M           rendering mode 0-3, or -1 for the level of detail (3)\n"
+      "  --voices V         sources rendered per block (%d)\n"
+      "  --groups G         render groups rendered in parallel (1)\n"
+      "  --regroup G        rebuild with G groups halfway, removing half the sources\n"
+      "  --attenuation A    distance model 0-3 (0, none)\n"
+      "  --room             render inside a reverberant room\n"
+      "  --output PATH      write the rendered stereo mix as a WAV file\n",
+      program, ResonanceWorld::kDefaultMaxVoices);
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--room") {
+      options->room = true;
+    } else if (arg == "--sources" && has_value) {
+      options->num_sources = std::atoi(argv[++i]);
+    } else if (arg == "--seconds" && has_value) {
+      options->seconds = std::atof(argv[++i]);
+    } else if (arg == "--sample-rate" && has_value) {
+      options->sample_rate = std::atoi(argv[++i]);
+    } else if (arg == "--frames" && has_value) {
+      options->frames_per_buffer = std::atoi(argv[++i]);
+    } else if (arg == "--mode" && has_value) {
+      options->rendering_mode = std::atoi(argv[++i]);
+    } else if (arg == "--voices" && has_value) {
+      options->max_voices = std::atoi(argv[++i]);
+    } else if (arg == "--groups" && has_value) {
+      options->render_groups = std::atoi(argv[++i]);
+    } else if (arg == "--regroup" && has_value) {
+      options->regroup = std::atoi(argv[++i]);
+    } else if (arg == "--attenuation" && has_value) {
+      options->distance_model = std::atoi(argv[++i]);
+    } else if (arg == "--output" && has_value) {
+      options->output = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return options->num_sources >= 0 && options->num_sources <= ResonanceWorld::kMaxSources &&
+         options->seconds > 0.0 && options->sample_rate > 0 &&
+         options->frames_per_buffer > 0 && options->render_groups >= 1 &&
+         options->render_groups <= ResonanceWorld::kMaxRenderGroups &&
+         options->regroup >= 0 && options->regroup <= ResonanceWorld::kMaxRenderGroups &&
+         options->distance_model >= kDistanceModelNone &&
+         options->distance_model <= kDistanceModelCustom &&
+         options->rendering_mode >= ResonanceWorld::kRenderingModeAuto &&
+         options->rendering_mode <= vraudio::kBinauralHighQuality;
+}
+
+// Scripted source: orbits the origin on its own radius, speed and height, and
+// plays a tone with a slow tremolo so that every source stays audible.
+struct BenchSource {
+  ResonanceWorld::SourceHandle handle;
+  float radius;
+  float angular_speed;
+  float phase;
+  float height;
+  float frequency;
+  double oscillator;
+};
+
+void MoveSource(ResonanceWorld* world, const BenchSource& source, double time) {
+  const float angle = source.phase + source.angular_speed * static_cast<float>(time);
+  const float bob = 0.5f * std::sin(0.7f * static_cast<float>(time) + source.phase);
+  world->SetSourceTransform(source.handle, source.radius * std::cos(angle), source.height + bob,
+                            source.radius * std::sin(angle), 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void Synthesize(BenchSource* source, int sample_rate, size_t num_frames, float* output) {
+  const double increment = 2.0 * M_PI * source->frequency / sample_rate;
+  for (size_t i = 0; i < num_frames; ++i) {
+    const float tremolo = 0.6f + 0.4f * std::sin(static_cast<float>(source->oscillator * 0.001));
+    output[i] = 0.1f * tremolo * static_cast<float>(std::sin(source->oscillator));
+    source->oscillator += increment;
+  }
+}
+
+double Percentile(const std::vector<double>& sorted, double percentile) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const size_t index = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return Allocate(size); }
+void* operator new[](std::size_t size) { return Allocate(size); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  ResonanceWorld world;
+  world.SetMaxVoices(options.max_voices);
+  world.SetRenderGroups(options.render_groups);
+  std::vector<BenchSource> sources(options.num_sources);
+  for (int i = 0; i < options.num_sources; ++i) {
+    BenchSource& source = sources[i];
+    source.handle = world.AddSource(vraudio::kBinauralHighQuality);
+    world.SetSourceRenderingMode(source.handle, options.rendering_mode);
+    world.SetSourceDistanceModel(source.handle, options.distance_model, 1.0f, 50.0f);
+    source.radius = 1.5f + static_cast<float>(i % 8);
+    source.angular_speed = (i % 2 == 0 ? 1.0f : -1.0f) * (0.2f + 0.05f * (i % 5));
+    source.phase = 2.0f * static_cast<float>(M_PI) * i / std::max(options.num_sources, 1);
+    source.height = static_cast<float>(i % 3) - 1.0f;
+    source.frequency = 110.0f * (1.0f + 0.25f * (i % 12));
+    source.oscillator = 0.0;
+    MoveSource(&world, source, 0.0);
+  }
+  if (options.room) {
+    vraudio::RoomProperties room;
+    room.dimensions[0] = 12.0f;
+    room.dimensions[1] = 4.0f;
+    room.dimensions[2] = 16.0f;
+    for (vraudio::MaterialName& material : room.material_names) {
+      material = vraudio::MaterialName::kPlasterSmooth;
+    }
+    world.SetRoomProperties(&room, nullptr);
+  }
+
+  // The graph is built in the background, as in the engine; only the
+  // rendering itself is measured.
+  world.Initialize(options.sample_rate, kNumOutputChannels, options.frames_per_buffer);
+  while (!world.HasGraph()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const size_t frames_per_buffer = static_cast<size_t>(options.frames_per_buffer);
+  const size_t num_blocks = static_cast<size_t>(
+      std::ceil(options.seconds * options.sample_rate / frames_per_buffer));
+  std::vector<float> input(frames_per_buffer);
+  std::vector<float> block(kNumOutputChannels * frames_per_buffer);
+  std::vector<float> mix;
+  if (!options.output.empty()) {
+    mix.reserve(num_blocks * block.size());
+  }
+  std::vector<double> block_times(num_blocks);
+  double render_time = 0.0;
+
+  for (size_t b = 0; b < num_blocks; ++b) {
+    if (options.regroup > 0 && b == num_blocks / 2) {
+      // The sources retire on the first block of the new graph, before any of
+      // the remaining ones is assigned to one of its groups.
+      world.SetRenderGroups(options.regroup);
+      world.Shutdown();
+      world.Initialize(options.sample_rate, kNumOutputChannels, options.frames_per_buffer);
+      while (!world.HasGraph()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      for (size_t i = 0; i < sources.size(); i += 2) {
+        world.RemoveSource(sources[i].handle);
+      }
+    }
+    // Game thread work: move everything and queue the next block of input.
+    const double time = static_cast<double>(b * frames_per_buffer) / options.sample_rate;
+    const float yaw = 0.1f * static_cast<float>(time);
+    world.SetListenerTransform(0.0f, 0.0f, 0.0f, 0.0f, std::sin(0.5f * yaw), 0.0f,
+                               std::cos(0.5f * yaw));
+    for (BenchSource& source : sources) {
+      MoveSource(&world, source, time);
+      Synthesize(&source, options.sample_rate, frames_per_buffer, input.data());
+      world.PushInput(source.handle, input.data(), frames_per_buffer);
+    }
+    world.UpdateRooms();
+
+    const auto start = std::chrono::steady_clock::now();
+    count_allocations = true;
+    world.Render(frames_per_buffer, block.data());
+    count_allocations = false;
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    block_times[b] = elapsed.count();
+    render_time += elapsed.count();
+    if (!options.output.empty()) {
+      mix.insert(mix.end(), block.begin(), block.end());
+    }
+  }
+
+  const double audio_time = static_cast<double>(num_blocks * frames_per_buffer) / options.sample_rate;
+  const double block_budget = static_cast<double>(frames_per_buffer) / options.sample_rate;
+  std::vector<double> sorted = block_times;
+  std::sort(sorted.begin(), sorted.end());
+  size_t overruns = 0;
+  for (const double block_time : block_times) {
+    overruns += block_time > block_budget ? 1 : 0;
+  }
+
+  std::printf(
+      "sources %d, mode %d, voices %d, groups %d, regroup %d, attenuation %d, %s, %d Hz, %zu frames per block\n",
+      options.num_sources, options.rendering_mode, options.max_voices, options.render_groups,
+      options.regroup,
+      options.distance_model, options.room ? "room" : "no room", options.sample_rate,
+      frames_per_buffer);
+  std::printf("rendered %.2f s of audio in %.3f s, real-time factor %.4f (%.1fx real time)\n",
+              audio_time, render_time, render_time / audio_time, audio_time / render_time);
+  std::printf("block latency (ms): p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f  budget %.3f\n",
+              1000.0 * Percentile(sorted, 50.0), 1000.0 * Percentile(sorted, 90.0),
+              1000.0 * Percentile(sorted, 99.0), 1000.0 * Percentile(sorted, 99.9),
+              1000.0 * sorted.back(), 1000.0 * block_budget);
+  std::printf("blocks over budget: %zu of %zu\n", overruns, num_blocks);
+  std::printf("allocations in Render(): %llu (%llu bytes)\n",
+              static_cast<unsigned long long>(num_allocations.load()),
+              static_cast<unsigned long long>(allocated_bytes.load()));
+
+  if (!options.output.empty()) {
+    if (!WriteWav(options.output.c_str(), mix.data(), kNumOutputChannels,
+                  mix.size() / kNumOutputChannels, options.sample_rate)) {
+      std::fprintf(stderr, "could not write %s\n", options.output.c_str());
+      return 1;
+    }
+    std::printf("wrote %s\n", options.output.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,334 @@
+#include "acoustic_bake.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "geometrical_acoustics/estimating_rt60.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kNumBands = vraudio::kNumReverbOctaveBands;
+
+// Time resolution of the energy decay the RT60s are estimated from.
+const float kDecayRate = 1000.0f;
+
+// Rays are dropped once their energy fell below this in every band, well
+// under the -60 dB the RT60 is defined by.
+const float kMinEnergy = 1e-8f;
+
+// Offset of a reflected ray from the surface, so it does not hit it again.
+const float kSurfaceOffset = 1e-3f;
+
+const float kUnitX[3] = {1.0f, 0.0f, 0.0f};
+const float kUnitY[3] = {0.0f, 1.0f, 0.0f};
+
+// Asset layout, little-endian like every platform Godot runs on.
+const char kAssetMagic[4] = {'G', 'D', 'R', 'A'};
+const uint32_t kAssetVersion = 1;
+
+struct AssetHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_rooms;
+  // sizeof(BakedRoom) of the writer.
+  uint32_t room_size;
+};
+
+float Dot(const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+// Uniformly distributed unit vector.
+void RandomDirection(std::mt19937* random, float* direction) {
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  const float z = 2.0f * uniform(*random) - 1.0f;
+  const float phi = vraudio::kTwoPi * uniform(*random);
+  const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+  direction[0] = r * std::cos(phi);
+  direction[1] = r * std::sin(phi);
+  direction[2] = z;
+}
+
+// Cosine weighted unit vector in the hemisphere around |normal|.
+void DiffuseDirection(std::mt19937* random, const float* normal, float* direction) {
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  // Orthonormal basis around the normal.
+  const float* axis = std::fabs(normal[0]) < 0.9f ? kUnitX : kUnitY;
+  float tangent[3] = {axis[1] * normal[2] - axis[2] * normal[1],
+                      axis[2] * normal[0] - axis[0] * normal[2],
+                      axis[0] * normal[1] - axis[1] * normal[0]};
+  const float length = std::sqrt(Dot(tangent, tangent));
+  for (float& value : tangent) {
+    value /= length;
+  }
+  const float bitangent[3] = {normal[1] * tangent[2] - normal[2] * tangent[1],
+                              normal[2] * tangent[0] - normal[0] * tangent[2],
+                              normal[0] * tangent[1] - normal[1] * tangent[0]};
+  const float u = uniform(*random);
+  const float phi = vraudio::kTwoPi * uniform(*random);
+  const float r = std::sqrt(u);
+  const float x = r * std::cos(phi);
+  const float y = r * std::sin(phi);
+  const float z = std::sqrt(std::max(0.0f, 1.0f - u));
+  for (int i = 0; i < 3; ++i) {
+    direction[i] = x * tangent[i] + y * bitangent[i] + z * normal[i];
+  }
+}
+
+// Adds |energies| in flight from |start| to |end| seconds to the decays.
+void AddSegment(float start, float end, const float* energies,
+                std::vector<float>* decays) {
+  const size_t num_bins = decays[0].size();
+  const float first = start * kDecayRate;
+  const float last = std::min(end * kDecayRate, static_cast<float>(num_bins));
+  for (size_t bin = static_cast<size_t>(first); static_cast<float>(bin) < last; ++bin) {
+    // Share of the bin the segment covers.
+    const float overlap = std::min(last, static_cast<float>(bin + 1)) -
+                          std::max(first, static_cast<float>(bin));
+    for (size_t band = 0; band < kNumBands; ++band) {
+      decays[band][bin] += overlap * energies[band];
+    }
+  }
+}
+
+}  // namespace
+
+bool BakeRt60s(const float* origin, const BakeSettings& settings, BakeRayFn cast_ray,
+               void* context, float* rt60s) {
+  std::fill(rt60s, rt60s + kNumBands, 0.0f);
+  const size_t num_bins = static_cast<size_t>(settings.max_time * kDecayRate);
+  if (settings.num_rays <= 0 || num_bins == 0) {
+    return false;
+  }
+  std::vector<float> decays[kNumBands];
+  for (std::vector<float>& decay : decays) {
+    decay.assign(num_bins, 0.0f);
+  }
+  std::mt19937 random(settings.seed);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  const float ray_energy = 1.0f / settings.num_rays;
+  bool hit_any = false;
+
+  for (int ray = 0; ray < settings.num_rays; ++ray) {
+    float position[3] = {origin[0], origin[1], origin[2]};
+    float direction[3];
+    RandomDirection(&random, direction);
+    float energies[kNumBands];
+    std::fill(energies, energies + kNumBands, ray_energy);
+    float time = 0.0f;
+    for (int bounce = 0; bounce < settings.max_bounces; ++bounce) {
+      const float max_distance = (settings.max_time - time) * vraudio::kSpeedOfSound;
+      BakeHit hit;
+      if (max_distance <= 0.0f ||
+          !cast_ray(context, position, direction, max_distance, &hit)) {
+        // Escaped or out of time; the energy leaves the decay here.
+        break;
+      }
+      hit_any = true;
+      const float arrival = time + hit.distance / vraudio::kSpeedOfSound;
+      AddSegment(time, arrival, energies, decays);
+      time = arrival;
+
+      float max_energy = 0.0f;
+      for (size_t band = 0; band < kNumBands; ++band) {
+        energies[band] *= 1.0f - std::min(std::max(hit.absorption[band], 0.0f), 1.0f);
+        max_energy = std::max(max_energy, energies[band]);
+      }
+      if (max_energy < kMinEnergy * ray_energy) {
+        break;
+      }
+
+      // Reflect off the side of the surface the ray came from.
+      float normal[3] = {hit.normal[0], hit.normal[1], hit.normal[2]};
+      if (Dot(normal, direction) > 0.0f) {
+        for (float& value : normal) {
+          value = -value;
+        }
+      }
+      for (int i = 0; i < 3; ++i) {
+        position[i] += hit.distance * direction[i] + kSurfaceOffset * normal[i];
+      }
+      if (uniform(random) < settings.scattering) {
+        DiffuseDirection(&random, normal, direction);
+      } else {
+        const float projection = 2.0f * Dot(direction, normal);
+        for (int i = 0; i < 3; ++i) {
+          direction[i] -= projection * normal[i];
+        }
+      }
+    }
+  }
+  if (!hit_any) {
+    return false;
+  }
+
+  // The energy still in flight follows the energy envelope of the impulse
+  // response of a diffuse room, which is what the estimate expects.
+  for (size_t band = 0; band < kNumBands; ++band) {
+    rt60s[band] = vraudio::EstimateRT60(decays[band], kDecayRate);
+  }
+  return true;
+}
+
+uint64_t BakeKey(const char* name) {
+  // 64 bit FNV-1a.
+  uint64_t hash = 14695981039346656037ull;
+  for (const char* c = name; *c != '\0'; ++c) {
+    hash ^= static_cast<uint8_t>(*c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool WriteBakedAcoustics(const std::string& path, std::vector<BakedRoom> rooms) {
+  std::sort(rooms.begin(), rooms.end(),
+            [](const BakedRoom& a, const BakedRoom& b) { return a.key < b.key; });
+  AssetHeader header;
+  std::memcpy(header.magic, kAssetMagic, sizeof(header.magic));
+  header.version = kAssetVersion;
+  header.num_rooms = static_cast<uint32_t>(rooms.size());
+  header.room_size = sizeof(BakedRoom);
+
+  const std::string temp_path = path + ".tmp";
+  FILE* file = std::fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  for (const BakedRoom& room : rooms) {
+    // Copied field by field so that the padding is written as zeros.
+    BakedRoom record;
+    std::memset(&record, 0, sizeof(record));
+    record.key = room.key;
+    std::copy(room.rt60s, room.rt60s + kNumBands, record.rt60s);
+    written = written && std::fwrite(&record, sizeof(record), 1, file) == 1;
+  }
+  written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+  written = written && MoveFileExA(temp_path.c_str(), path.c_str(),
+                                   MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  written = written && std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+  if (!written) {
+    std::remove(temp_path.c_str());
+  }
+  return written;
+}
+
+BakedAcoustics::BakedAcoustics()
+    : mapping_(nullptr), mapping_size_(0), rooms_(nullptr), num_rooms_(0) {}
+
+BakedAcoustics::~BakedAcoustics() { Release(); }
+
+bool BakedAcoustics::Map(const std::string& path) {
+  Release();
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  // The view keeps the mapping and the file alive.
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    return false;
+  }
+  mapping_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (mapping_ == nullptr) {
+    return false;
+  }
+  mapping_size_ = static_cast<size_t>(size.QuadPart);
+#else
+  const int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  }
+  // The mapping stays valid after the descriptor is closed.
+  close(file);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  mapping_ = mapping;
+  mapping_size_ = static_cast<size_t>(status.st_size);
+#endif
+  if (!Attach(static_cast<const uint8_t*>(mapping_), mapping_size_)) {
+    Release();
+    return false;
+  }
+  return true;
+}
+
+bool BakedAcoustics::Load(const uint8_t* data, size_t size) {
+  Release();
+  if (data == nullptr) {
+    return false;
+  }
+  // Copied into 64 bit words so that the records are aligned.
+  copy_.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  std::memcpy(copy_.data(), data, size);
+  if (!Attach(reinterpret_cast<const uint8_t*>(copy_.data()), size)) {
+    Release();
+    return false;
+  }
+  return true;
+}
+
+void BakedAcoustics::Release() {
+  if (mapping_ != nullptr) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, mapping_size_);
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+  std::vector<uint64_t>().swap(copy_);
+  rooms_ = nullptr;
+  num_rooms_ = 0;
+}
+
+const BakedRoom* BakedAcoustics::Find(uint64_t key) const {
+  const BakedRoom* end = rooms_ + num_rooms_;
+  const BakedRoom* room = std::lower_bound(
+      rooms_, end, key, [](const BakedRoom& a, uint64_t b) { return a.key < b; });
+  return room != end && room->key == key ? room : nullptr;
+}
+
+bool BakedAcoustics::Attach(const uint8_t* data, size_t size) {
+  AssetHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kAssetMagic, sizeof(header.magic)) != 0 ||
+      header.version != kAssetVersion || header.room_size != sizeof(BakedRoom) ||
+      (size - sizeof(header)) / sizeof(BakedRoom) < header.num_rooms) {
+    return false;
+  }
+  rooms_ = reinterpret_cast<const BakedRoom*>(data + sizeof(header));
+  num_rooms_ = header.num_rooms;
+  return true;
+}
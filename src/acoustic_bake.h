@@ -0,0 +1,105 @@
+#ifndef GDRESONANCE_ACOUSTIC_BAKE_H
+#define GDRESONANCE_ACOUSTIC_BAKE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/constants_and_types.h"
+
+// Offline room acoustics: energy ray tracing of a room into RT60s, and the
+// binary asset the results are stored in and memory-mapped from at load.
+// Nothing here touches Godot; the scene is ray cast through a BakeRayFn.
+
+// Surface found by a BakeRayFn.
+struct BakeHit {
+  float distance;
+  // Unit normal of the surface.
+  float normal[3];
+  // Share of the incident energy the surface absorbs, per octave band.
+  float absorption[vraudio::kNumReverbOctaveBands];
+};
+
+// Casts a ray of at most |max_distance| from |origin| along the unit vector
+// |direction| and fills |hit| with the first surface on the way. Returns
+// false when the ray hits nothing.
+typedef bool (*BakeRayFn)(void* context, const float* origin, const float* direction,
+                          float max_distance, BakeHit* hit);
+
+struct BakeSettings {
+  // Rays traced from the probe position.
+  int num_rays = 4096;
+  // Reflections followed per ray at most.
+  int max_bounces = 500;
+  // Longest reverb tracked, in seconds.
+  float max_time = 4.0f;
+  // Share of the reflected energy scattered diffusely rather than specularly.
+  float scattering = 0.3f;
+  // Seed of the ray directions, so that a bake is reproducible.
+  uint32_t seed = 1;
+};
+
+// Traces |settings.num_rays| rays from |origin| through the scene of
+// |cast_ray| and estimates the RT60 of every octave band from the decay of
+// the energy they carry. Bands without a measurable decay, as in open space,
+// get 0. Returns false when no ray hit anything.
+bool BakeRt60s(const float* origin, const BakeSettings& settings, BakeRayFn cast_ray,
+               void* context, float* rt60s);
+
+// Key of a baked room, hashed from a name that is stable across loads, such
+// as the path of the room node within its scene.
+uint64_t BakeKey(const char* name);
+
+// Baked acoustics of one room, as stored in the asset.
+struct BakedRoom {
+  uint64_t key;
+  float rt60s[vraudio::kNumReverbOctaveBands];
+};
+
+// Writes |rooms| as a baked acoustics asset to |path|. The file is replaced
+// through a rename, which fails on Windows while the previous version is
+// mapped, so release every mapping of it first. Returns false when it cannot
+// be written.
+bool WriteBakedAcoustics(const std::string& path, std::vector<BakedRoom> rooms);
+
+// Read-only view of a baked acoustics asset: a small header followed by the
+// BakedRoom records sorted by key. Lookups are a binary search straight into
+// the mapped file, so loading costs no parsing or copying.
+class BakedAcoustics {
+public:
+    BakedAcoustics();
+    ~BakedAcoustics();
+
+    BakedAcoustics(const BakedAcoustics&) = delete;
+    BakedAcoustics& operator=(const BakedAcoustics&) = delete;
+
+    // Maps the asset at |path|. Returns false when the file cannot be mapped
+    // or is not an asset of this version.
+    bool Map(const std::string& path);
+
+    // Copies the asset in |data|, for files that cannot be mapped such as
+    // those inside an exported pack.
+    bool Load(const uint8_t* data, size_t size);
+
+    // Unmaps or frees the asset.
+    void Release();
+
+    // Record of |key|, or null. Valid until the asset is released.
+    const BakedRoom* Find(uint64_t key) const;
+
+    size_t num_rooms() const { return num_rooms_; }
+    const BakedRoom* rooms() const { return rooms_; }
+
+private:
+    // Points |rooms_| into |data| when it holds a valid asset.
+    bool Attach(const uint8_t* data, size_t size);
+
+    void* mapping_;
+    size_t mapping_size_;
+    std::vector<uint64_t> copy_;
+    const BakedRoom* rooms_;
+    size_t num_rooms_;
+};
+
+#endif // GDRESONANCE_ACOUSTIC_BAKE_H
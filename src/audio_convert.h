@@ -0,0 +1,131 @@
+#ifndef GDRESONANCE_AUDIO_CONVERT_H
+#define GDRESONANCE_AUDIO_CONVERT_H
+
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GDRESONANCE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Conversion kernels between interleaved stereo, the layout of Godot's
+// AudioFrame, and the mono/planar buffers handed to ResonanceAudio, and the
+// level scan that tells silent blocks apart.
+//
+// The instruction set is picked at compile time: AVX2 when the build enables
+// it (scons avx2=yes), otherwise SSE2 on x86-64 and NEON on ARM64, which both
+// targets always have. Frames left over by the vector loop take the scalar
+// path, so any frame count and alignment is accepted.
+
+// Averages both channels of |num_frames| interleaved stereo frames.
+inline void DownmixStereo(const float* __restrict input, size_t num_frames,
+                          float* __restrict output) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 half = _mm256_set1_ps(0.5f);
+  for (; i + 8 <= num_frames; i += 8) {
+    const __m256 a = _mm256_loadu_ps(input + 2 * i);
+    const __m256 b = _mm256_loadu_ps(input + 2 * i + 8);
+    // hadd sums adjacent pairs per 128-bit lane: L0+R0 L1+R1 L4+R4 L5+R5 | ...
+    const __m256 sum = _mm256_hadd_ps(a, b);
+    const __m256 ordered = _mm256_castpd_ps(
+        _mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(output + i, _mm256_mul_ps(ordered, half));
+  }
+#elif defined(GDRESONANCE_SSE2)
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (; i + 4 <= num_frames; i += 4) {
+    const __m128 a = _mm_loadu_ps(input + 2 * i);
+    const __m128 b = _mm_loadu_ps(input + 2 * i + 4);
+    const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 4 <= num_frames; i += 4) {
+    const float32x4x2_t frames = vld2q_f32(input + 2 * i);
+    vst1q_f32(output + i, vmulq_n_f32(vaddq_f32(frames.val[0], frames.val[1]), 0.5f));
+  }
+#endif
+  for (; i < num_frames; ++i) {
+    output[i] = 0.5f * (input[2 * i] + input[2 * i + 1]);
+  }
+}
+
+// Splits |num_frames| interleaved stereo frames into two planar channels.
+inline void DeinterleaveStereo(const float* __restrict input, size_t num_frames,
+                               float* __restrict left, float* __restrict right) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= num_frames; i += 8) {
+    const __m256 a = _mm256_loadu_ps(input + 2 * i);
+    const __m256 b = _mm256_loadu_ps(input + 2 * i + 8);
+    // Shuffles work per 128-bit lane: L0 L1 L4 L5 | L2 L3 L6 L7.
+    const __m256d l = _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m256d r = _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(l, _MM_SHUFFLE(3, 1, 2, 0))));
+    _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(r, _MM_SHUFFLE(3, 1, 2, 0))));
+  }
+#elif defined(GDRESONANCE_SSE2)
+  for (; i + 4 <= num_frames; i += 4) {
+    const __m128 a = _mm_loadu_ps(input + 2 * i);
+    const __m128 b = _mm_loadu_ps(input + 2 * i + 4);
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 4 <= num_frames; i += 4) {
+    const float32x4x2_t frames = vld2q_f32(input + 2 * i);
+    vst1q_f32(left + i, frames.val[0]);
+    vst1q_f32(right + i, frames.val[1]);
+  }
+#endif
+  for (; i < num_frames; ++i) {
+    left[i] = input[2 * i];
+    right[i] = input[2 * i + 1];
+  }
+}
+
+// Largest absolute value of |num_samples| samples, 0 for none.
+inline float PeakLevel(const float* samples, size_t num_samples) {
+  size_t i = 0;
+  float peak = 0.0f;
+#if defined(__AVX2__)
+  // Clearing the sign bit takes the absolute value.
+  const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 peaks = _mm256_setzero_ps();
+  for (; i + 8 <= num_samples; i += 8) {
+    peaks = _mm256_max_ps(peaks, _mm256_and_ps(_mm256_loadu_ps(samples + i), magnitude));
+  }
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(peaks), _mm256_extractf128_ps(peaks, 1));
+  half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_max_ss(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 1, 1, 1)));
+  peak = _mm_cvtss_f32(half);
+#elif defined(GDRESONANCE_SSE2)
+  const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peaks = _mm_setzero_ps();
+  for (; i + 4 <= num_samples; i += 4) {
+    peaks = _mm_max_ps(peaks, _mm_and_ps(_mm_loadu_ps(samples + i), magnitude));
+  }
+  peaks = _mm_max_ps(peaks, _mm_movehl_ps(peaks, peaks));
+  peaks = _mm_max_ss(peaks, _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(1, 1, 1, 1)));
+  peak = _mm_cvtss_f32(peaks);
+#elif defined(__ARM_NEON)
+  float32x4_t peaks = vdupq_n_f32(0.0f);
+  for (; i + 4 <= num_samples; i += 4) {
+    peaks = vmaxq_f32(peaks, vabsq_f32(vld1q_f32(samples + i)));
+  }
+  peak = vmaxvq_f32(peaks);
+#endif
+  for (; i < num_samples; ++i) {
+    const float value = samples[i] < 0.0f ? -samples[i] : samples[i];
+    peak = value > peak ? value : peak;
+  }
+  return peak;
+}
+
+#endif // GDRESONANCE_AUDIO_CONVERT_H
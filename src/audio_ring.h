@@ -0,0 +1,102 @@
+#ifndef GDRESONANCE_AUDIO_RING_H
+#define GDRESONANCE_AUDIO_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "audio_convert.h"
+
+// Single-producer/single-consumer ring of interleaved float frames. The storage
+// is sized by Allocate() outside of the audio thread; Write(), Read(), Skip()
+// and PeakLevel() never allocate and may run on different threads.
+class AudioRing {
+public:
+    AudioRing() : num_channels_(0), capacity_(0), read_(0), write_(0) {}
+
+    // Resizes the ring and drops its contents. Must not race with Write/Read.
+    void Allocate(size_t num_channels, size_t capacity_frames) {
+      num_channels_ = num_channels;
+      capacity_ = capacity_frames;
+      buffer_.assign(num_channels * capacity_frames, 0.0f);
+      read_.store(0, std::memory_order_relaxed);
+      write_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t num_channels() const { return num_channels_; }
+    size_t capacity() const { return capacity_; }
+
+    // Number of frames the consumer can read.
+    size_t AvailableRead() const {
+      return write_.load(std::memory_order_acquire) -
+             read_.load(std::memory_order_relaxed);
+    }
+
+    // Number of frames the producer can write.
+    size_t AvailableWrite() const {
+      return capacity_ - (write_.load(std::memory_order_relaxed) -
+                          read_.load(std::memory_order_acquire));
+    }
+
+    // Copies up to |num_frames| frames in and returns how many were written.
+    size_t Write(const float* input, size_t num_frames) {
+      const size_t frames = std::min(num_frames, AvailableWrite());
+      const size_t write = write_.load(std::memory_order_relaxed);
+      const size_t offset = write % capacity_;
+      const size_t first = std::min(frames, capacity_ - offset);
+      std::copy(input, input + first * num_channels_,
+                buffer_.data() + offset * num_channels_);
+      std::copy(input + first * num_channels_, input + frames * num_channels_,
+                buffer_.data());
+      write_.store(write + frames, std::memory_order_release);
+      return frames;
+    }
+
+    // Copies up to |num_frames| frames out and returns how many were read.
+    size_t Read(float* output, size_t num_frames) {
+      const size_t frames = std::min(num_frames, AvailableRead());
+      const size_t read = read_.load(std::memory_order_relaxed);
+      const size_t offset = read % capacity_;
+      const size_t first = std::min(frames, capacity_ - offset);
+      const float* data = buffer_.data();
+      std::copy(data + offset * num_channels_,
+                data + (offset + first) * num_channels_, output);
+      std::copy(data, data + (frames - first) * num_channels_,
+                output + first * num_channels_);
+      read_.store(read + frames, std::memory_order_release);
+      return frames;
+    }
+
+    // Peak level of the next |num_frames| frames, or of all readable frames
+    // when fewer are queued, without consuming them. Consumer only.
+    float PeakLevel(size_t num_frames) const {
+      const size_t frames = std::min(num_frames, AvailableRead());
+      if (frames == 0) {
+        return 0.0f;
+      }
+      const size_t offset = read_.load(std::memory_order_relaxed) % capacity_;
+      const size_t first = std::min(frames, capacity_ - offset);
+      const float* data = buffer_.data();
+      return std::max(::PeakLevel(data + offset * num_channels_, first * num_channels_),
+                      ::PeakLevel(data, (frames - first) * num_channels_));
+    }
+
+    // Drops up to |num_frames| frames and returns how many were dropped.
+    size_t Skip(size_t num_frames) {
+      const size_t frames = std::min(num_frames, AvailableRead());
+      read_.store(read_.load(std::memory_order_relaxed) + frames,
+                  std::memory_order_release);
+      return frames;
+    }
+
+private:
+    std::vector<float> buffer_;
+    size_t num_channels_;
+    size_t capacity_;
+    // Monotonic frame counters, wrapped into the buffer on access.
+    std::atomic<size_t> read_;
+    std::atomic<size_t> write_;
+};
+
+#endif // GDRESONANCE_AUDIO_RING_H
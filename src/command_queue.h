@@ -0,0 +1,62 @@
+#ifndef GDRESONANCE_COMMAND_QUEUE_H
+#define GDRESONANCE_COMMAND_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// Fixed-capacity single-producer/single-consumer queue of POD commands. Push()
+// and Pop() are wait-free and never allocate. The indices live on separate
+// cache lines so producer and consumer do not contend.
+template <typename T, size_t kCapacity>
+class CommandQueue {
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "Commands must be trivially copyable");
+
+public:
+    CommandQueue() : head_(0), tail_(0) {}
+
+    // Producer side. Returns false and drops |command| when the queue is full.
+    bool Push(const T& command) {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+        return false;
+      }
+      items_[tail & (kCapacity - 1)] = command;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Producer side. Pushes as many of the |count| |commands| as fit and
+    // publishes them at once, so the consumer pops all of them in the same
+    // drain. Returns the number pushed.
+    size_t Push(const T* commands, size_t count) {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      const size_t pushed =
+          std::min(count, kCapacity - (tail - head_.load(std::memory_order_acquire)));
+      for (size_t i = 0; i < pushed; ++i) {
+        items_[(tail + i) & (kCapacity - 1)] = commands[i];
+      }
+      tail_.store(tail + pushed, std::memory_order_release);
+      return pushed;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool Pop(T* command) {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      *command = items_[head & (kCapacity - 1)];
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) T items_[kCapacity];
+};
+
+#endif // GDRESONANCE_COMMAND_QUEUE_H
@@ -1,9 +1,25 @@
 #include "gdresonance.h"
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/math.hpp>
 
+#include <godot_cpp/classes/audio_server.hpp>
 #include <godot_cpp/classes/audio_stream_generator_playback.hpp>
 #include <godot_cpp/classes/audio_stream_playback.hpp>
-
+#include <godot_cpp/classes/audio_stream_wav.hpp>
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/performance.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "audio_convert.h"
+#include "wav_file.h"
 
 #include "base/audio_buffer.h"
 #include "base/constants_and_types.h"
@@ -16,34 +32,89 @@ using namespace godot;
 
 //Resonance
 const size_t kNumOutputChannels = 2;
-const size_t kSampleRate = 44100;
-
-struct ResonanceAudioSystem {
-  ResonanceAudioSystem(int sample_rate, size_t num_channels, size_t frames_per_buffer) : api(vraudio::CreateResonanceAudioApi(num_channels, frames_per_buffer,sample_rate)) {}
+// Used when the AudioServer reports no mix rate.
+const int kSampleRate = 44100;
 
-  // ResonanceAudio API instance to communicate with the internal system.
-  std::unique_ptr<vraudio::ResonanceAudioApi> api;
-
-  // Default room properties, which effectively disable the room effects.
-  vraudio::ReflectionProperties null_reflection_properties;
-  vraudio::ReverbProperties null_reverb_properties;
-};
+// Looks up the renderer shared by the effects and nodes naming the same world.
+static ResonanceWorld *get_resonance_world(const StringName &name) {
+  return ResonanceWorld::Get(String(name).utf8().get_data());
+}
 
-static std::shared_ptr<ResonanceAudioSystem> resonance_audio = nullptr;
+// Decodes the PCM frames of |stream| for the streamer, or returns null.
+// GDExtensions cannot mix arbitrary streams through AudioStreamPlayback in
+// Godot 4.1, so only uncompressed AudioStreamWAV data is supported.
+static std::shared_ptr<const StreamClip> decode_stream(const Ref<AudioStream> &stream) {
+  if (stream.is_null()) {
+    return nullptr;
+  }
+  const Ref<AudioStreamWAV> wav = stream;
+  ERR_FAIL_COND_V_MSG(wav.is_null(), nullptr, "GDResonanceSource only plays AudioStreamWAV streams.");
+  const AudioStreamWAV::Format format = wav->get_format();
+  ERR_FAIL_COND_V_MSG(format != AudioStreamWAV::FORMAT_8_BITS && format != AudioStreamWAV::FORMAT_16_BITS,
+                      nullptr, "GDResonanceSource only plays 8 and 16 bit PCM AudioStreamWAV streams.");
+
+  const PackedByteArray data = wav->get_data();
+  const uint8_t *bytes = data.ptr();
+  auto clip = std::make_shared<StreamClip>();
+  clip->num_channels = wav->is_stereo() ? 2 : 1;
+  clip->sample_rate = wav->get_mix_rate();
+  const size_t sample_size = format == AudioStreamWAV::FORMAT_16_BITS ? 2 : 1;
+  const size_t num_samples = data.size() / sample_size;
+  clip->num_frames = num_samples / clip->num_channels;
+  clip->samples.resize(clip->num_frames * clip->num_channels);
+  for (size_t i = 0; i < clip->samples.size(); i++) {
+    if (sample_size == 2) {
+      // Little-endian signed 16 bit.
+      const int16_t sample = static_cast<int16_t>(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+      clip->samples[i] = sample / 32768.0f;
+    } else {
+      clip->samples[i] = static_cast<int8_t>(bytes[i]) / 128.0f;
+    }
+  }
+  // Ping-pong and backward loops play forward.
+  const size_t loop_begin = static_cast<size_t>(MAX(wav->get_loop_begin(), 0));
+  const size_t loop_end = static_cast<size_t>(MAX(wav->get_loop_end(), 0));
+  clip->loop = wav->get_loop_mode() != AudioStreamWAV::LOOP_DISABLED && loop_begin < loop_end &&
+               loop_end <= clip->num_frames;
+  clip->loop_begin = clip->loop ? loop_begin : 0;
+  clip->loop_end = clip->loop ? loop_end : clip->num_frames;
+  return clip;
+}
 
-vraudio::ResonanceAudioApi::SourceId mId1 = 0;
-vraudio::ResonanceAudioApi::SourceId mId2 = 1;
+// Godot's AudioFrame is a pair of packed floats, so bus buffers are read and
+// rendered in place as interleaved stereo. Any other layout goes through the
+// scratch buffers.
+static constexpr bool kInterleavedAudioFrame =
+    sizeof(AudioFrame) == 2 * sizeof(float) && offsetof(AudioFrame, right) == sizeof(float);
+
+// Returns |count| frames as interleaved stereo, copied into |scratch| only when
+// the layout of AudioFrame does not match.
+static const float *interleaved_frames(const AudioFrame *frames, int32_t count, float *scratch) {
+  if (kInterleavedAudioFrame) {
+    return reinterpret_cast<const float *>(frames);
+  }
+  for (int32_t i = 0; i < count; i++) {
+    scratch[2 * i] = frames[i].left;
+    scratch[2 * i + 1] = frames[i].right;
+  }
+  return scratch;
+}
 
+// Rate the AudioServer mixes at, which the graphs are built for so that no
+// resampling is needed.
+static int get_mix_rate() {
+  const double mix_rate = AudioServer::get_singleton()->get_mix_rate();
+  return mix_rate > 0.0 ? static_cast<int>(mix_rate) : kSampleRate;
+}
 
+// Native block size of the graph. Godot mixes its buses in blocks of this size.
+// Bus blocks of any size are cut into chunks
+// of at most this many frames and re-blocked by ResonanceWorld::Render().
 const int nFrames = 512;
 
-float inp1[nFrames];
-float inp2[nFrames];
-float out[nFrames*kNumOutputChannels];
-
-float px1 = 0.0f;
-float py1 = 0.0f;
-float pz1 = 0.0f;
+// Movement below these thresholds is not pushed to the renderer.
+const real_t kPositionThreshold = 0.001f;
+const real_t kRotationThreshold = 1e-6f;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //ResonanceEffect
@@ -52,7 +123,19 @@ float pz1 = 0.0f;
 Ref<AudioEffectInstance> GDResonanceEffect::_instantiate(){
   Ref<GDResonance> ins;
 	ins.instantiate();
-	ins->base = Ref<GDResonance>(this);
+	ins->base = Ref<GDResonanceEffect>(this);
+	ResonanceWorld *resonance_world = get_resonance_world(world);
+	for (int i = 0; i < kNumPooledRenderingModes; i++) {
+	  resonance_world->SetSourcePoolSize(static_cast<vraudio::RenderingMode>(i), source_pool_sizes[i]);
+	}
+	resonance_world->SetSoundfieldPoolSize(soundfield_pool_size);
+	resonance_world->SetRenderGroups(render_groups);
+	ins->Attach(resonance_world);
+	ins->world->SetMaxVoices(max_voices);
+	ins->world->SetLodDistances(lod_distances[0], lod_distances[1], lod_distances[2]);
+	ins->world->SetLodBudget(lod_budget);
+	UpdateDistanceCurve();
+	AddMonitors();
 	return ins;
 }
 
@@ -66,9 +149,48 @@ void GDResonanceEffect::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_y"), &GDResonanceEffect::GetY);
 	ClassDB::bind_method(D_METHOD("get_z"), &GDResonanceEffect::GetZ);
 
+  ClassDB::bind_method(D_METHOD("set_world", "world"), &GDResonanceEffect::SetWorld);
+  ClassDB::bind_method(D_METHOD("get_world"), &GDResonanceEffect::GetWorld);
+  ClassDB::bind_method(D_METHOD("set_max_voices", "max_voices"), &GDResonanceEffect::SetMaxVoices);
+  ClassDB::bind_method(D_METHOD("get_max_voices"), &GDResonanceEffect::GetMaxVoices);
+  ClassDB::bind_method(D_METHOD("set_lod_high_distance", "distance"), &GDResonanceEffect::SetLodHighDistance);
+  ClassDB::bind_method(D_METHOD("set_lod_medium_distance", "distance"), &GDResonanceEffect::SetLodMediumDistance);
+  ClassDB::bind_method(D_METHOD("set_lod_low_distance", "distance"), &GDResonanceEffect::SetLodLowDistance);
+  ClassDB::bind_method(D_METHOD("get_lod_high_distance"), &GDResonanceEffect::GetLodHighDistance);
+  ClassDB::bind_method(D_METHOD("get_lod_medium_distance"), &GDResonanceEffect::GetLodMediumDistance);
+  ClassDB::bind_method(D_METHOD("get_lod_low_distance"), &GDResonanceEffect::GetLodLowDistance);
+  ClassDB::bind_method(D_METHOD("set_lod_budget", "budget"), &GDResonanceEffect::SetLodBudget);
+  ClassDB::bind_method(D_METHOD("get_lod_budget"), &GDResonanceEffect::GetLodBudget);
+  ClassDB::bind_method(D_METHOD("set_source_pool_size", "rendering_mode", "size"), &GDResonanceEffect::SetSourcePoolSize);
+  ClassDB::bind_method(D_METHOD("get_source_pool_size", "rendering_mode"), &GDResonanceEffect::GetSourcePoolSize);
+  ClassDB::bind_method(D_METHOD("set_soundfield_pool_size", "size"), &GDResonanceEffect::SetSoundfieldPoolSize);
+  ClassDB::bind_method(D_METHOD("get_soundfield_pool_size"), &GDResonanceEffect::GetSoundfieldPoolSize);
+  ClassDB::bind_method(D_METHOD("set_render_groups", "render_groups"), &GDResonanceEffect::SetRenderGroups);
+  ClassDB::bind_method(D_METHOD("get_render_groups"), &GDResonanceEffect::GetRenderGroups);
+  ClassDB::bind_method(D_METHOD("set_distance_curve", "curve"), &GDResonanceEffect::SetDistanceCurve);
+  ClassDB::bind_method(D_METHOD("get_distance_curve"), &GDResonanceEffect::GetDistanceCurve);
+  ClassDB::bind_method(D_METHOD("_update_distance_curve"), &GDResonanceEffect::UpdateDistanceCurve);
+  ClassDB::bind_method(D_METHOD("set_source_transforms", "ids", "positions", "rotations"), &GDResonanceEffect::SetSourceTransforms, DEFVAL(PackedFloat32Array()));
+  ClassDB::bind_method(D_METHOD("set_source_gains", "ids", "gains"), &GDResonanceEffect::SetSourceGains);
+  ClassDB::bind_method(D_METHOD("get_stats"), &GDResonanceEffect::GetStats);
+  ClassDB::bind_method(D_METHOD("_get_monitor", "key"), &GDResonanceEffect::GetMonitor);
+
   ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "x", PROPERTY_HINT_RANGE, "-100.0,100.0,suffix:m"), "set_x", "get_x");
   ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "y", PROPERTY_HINT_RANGE, "-100.0,100.0,suffix:m"), "set_y", "get_y");
   ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "z", PROPERTY_HINT_RANGE, "-100.0,100.0,suffix:m"), "set_z", "get_z");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::STRING_NAME, "world"), "set_world", "get_world");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "max_voices", PROPERTY_HINT_RANGE, "0,256"), "set_max_voices", "get_max_voices");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "lod_high_distance", PROPERTY_HINT_RANGE, "0.0,1000.0,0.1,suffix:m"), "set_lod_high_distance", "get_lod_high_distance");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "lod_medium_distance", PROPERTY_HINT_RANGE, "0.0,1000.0,0.1,suffix:m"), "set_lod_medium_distance", "get_lod_medium_distance");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "lod_low_distance", PROPERTY_HINT_RANGE, "0.0,1000.0,0.1,suffix:m"), "set_lod_low_distance", "get_lod_low_distance");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::FLOAT, "lod_budget", PROPERTY_HINT_RANGE, "0.0,256.0,0.25"), "set_lod_budget", "get_lod_budget");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "source_pool_stereo_panning", PROPERTY_HINT_RANGE, "0,256"), "set_source_pool_size", "get_source_pool_size", vraudio::kStereoPanning);
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "source_pool_binaural_low", PROPERTY_HINT_RANGE, "0,256"), "set_source_pool_size", "get_source_pool_size", vraudio::kBinauralLowQuality);
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "source_pool_binaural_medium", PROPERTY_HINT_RANGE, "0,256"), "set_source_pool_size", "get_source_pool_size", vraudio::kBinauralMediumQuality);
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "source_pool_binaural_high", PROPERTY_HINT_RANGE, "0,256"), "set_source_pool_size", "get_source_pool_size", vraudio::kBinauralHighQuality);
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "soundfield_pool_size", PROPERTY_HINT_RANGE, "0,64"), "set_soundfield_pool_size", "get_soundfield_pool_size");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::INT, "render_groups", PROPERTY_HINT_RANGE, "1,8"), "set_render_groups", "get_render_groups");
+  ClassDB::add_property("GDResonanceEffect", PropertyInfo(Variant::OBJECT, "distance_curve", PROPERTY_HINT_RESOURCE_TYPE, "Curve"), "set_distance_curve", "get_distance_curve");
 }
 
 GDResonanceEffect::GDResonanceEffect() {
@@ -76,10 +198,21 @@ GDResonanceEffect::GDResonanceEffect() {
     px=0.0f;
     py=0.0f;
     pz=0.0f;
+    max_voices = ResonanceWorld::kDefaultMaxVoices;
+    lod_distances[0] = 5.0f;
+    lod_distances[1] = 15.0f;
+    lod_distances[2] = 40.0f;
+    lod_budget = 16.0f;
+    for (int i = 0; i < kNumPooledRenderingModes; i++) {
+      source_pool_sizes[i] = ResonanceWorld::kDefaultSourcePoolSize;
+    }
+    soundfield_pool_size = ResonanceWorld::kDefaultSoundfieldPoolSize;
+    render_groups = 1;
 }
 
 GDResonanceEffect::~GDResonanceEffect() {
     // Add your cleanup here.
+    RemoveMonitors();
 }
 
 void GDResonanceEffect::SetX(float x){
@@ -106,266 +239,531 @@ float GDResonanceEffect::GetZ() const {
   return pz;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//Resonance
-////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void GDResonanceEffect::SetWorld(const StringName &p_world){
+  world = p_world;
+  if (!monitor_world.is_empty()) {
+    AddMonitors();
+  }
+}
 
+StringName GDResonanceEffect::GetWorld() const {
+  return world;
+}
 
+void GDResonanceEffect::SetMaxVoices(int p_max_voices){
+  max_voices = p_max_voices;
+  get_resonance_world(world)->SetMaxVoices(max_voices);
+}
 
-void GDResonance::Initialize(int sample_rate, size_t num_channels, size_t frames_per_buffer) {
-  CHECK_GE(sample_rate, 0);
-  CHECK_EQ(num_channels, kNumOutputChannels);
-  CHECK_GE(frames_per_buffer, 0);
-  resonance_audio = std::make_shared<ResonanceAudioSystem>(sample_rate, num_channels, frames_per_buffer);
+int GDResonanceEffect::GetMaxVoices() const {
+  return max_voices;
 }
 
-void GDResonance::Shutdown() { resonance_audio.reset(); }
+void GDResonanceEffect::SetLodHighDistance(float p_distance){
+  lod_distances[0] = p_distance;
+  get_resonance_world(world)->SetLodDistances(lod_distances[0], lod_distances[1], lod_distances[2]);
+}
 
-void GDResonance::ProcessListener(size_t num_frames, float* output) {
-  CHECK(output != nullptr);
+void GDResonanceEffect::SetLodMediumDistance(float p_distance){
+  lod_distances[1] = p_distance;
+  get_resonance_world(world)->SetLodDistances(lod_distances[0], lod_distances[1], lod_distances[2]);
+}
 
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy == nullptr) {
-    return;
+void GDResonanceEffect::SetLodLowDistance(float p_distance){
+  lod_distances[2] = p_distance;
+  get_resonance_world(world)->SetLodDistances(lod_distances[0], lod_distances[1], lod_distances[2]);
+}
+
+float GDResonanceEffect::GetLodHighDistance() const {
+  return lod_distances[0];
+}
+
+float GDResonanceEffect::GetLodMediumDistance() const {
+  return lod_distances[1];
+}
+
+float GDResonanceEffect::GetLodLowDistance() const {
+  return lod_distances[2];
+}
+
+void GDResonanceEffect::SetLodBudget(float p_budget){
+  lod_budget = p_budget;
+  get_resonance_world(world)->SetLodBudget(lod_budget);
+}
+
+float GDResonanceEffect::GetLodBudget() const {
+  return lod_budget;
+}
+
+void GDResonanceEffect::SetSourcePoolSize(int p_rendering_mode, int p_size){
+  ERR_FAIL_INDEX(p_rendering_mode, kNumPooledRenderingModes);
+  source_pool_sizes[p_rendering_mode] = MAX(p_size, 0);
+  // Applies to the graphs built from now on.
+  get_resonance_world(world)->SetSourcePoolSize(static_cast<vraudio::RenderingMode>(p_rendering_mode), source_pool_sizes[p_rendering_mode]);
+}
+
+int GDResonanceEffect::GetSourcePoolSize(int p_rendering_mode) const {
+  ERR_FAIL_INDEX_V(p_rendering_mode, kNumPooledRenderingModes, 0);
+  return source_pool_sizes[p_rendering_mode];
+}
+
+void GDResonanceEffect::SetSoundfieldPoolSize(int p_size){
+  soundfield_pool_size = MAX(p_size, 0);
+  // Applies to the graphs built from now on.
+  get_resonance_world(world)->SetSoundfieldPoolSize(soundfield_pool_size);
+}
+
+int GDResonanceEffect::GetSoundfieldPoolSize() const {
+  return soundfield_pool_size;
+}
+
+void GDResonanceEffect::SetRenderGroups(int p_render_groups){
+  render_groups = CLAMP(p_render_groups, 1, ResonanceWorld::kMaxRenderGroups);
+  // Applies to the graphs built from now on.
+  get_resonance_world(world)->SetRenderGroups(render_groups);
+}
+
+int GDResonanceEffect::GetRenderGroups() const {
+  return render_groups;
+}
+
+void GDResonanceEffect::SetDistanceCurve(const Ref<Curve> &p_curve){
+  const Callable changed(this, "_update_distance_curve");
+  if (distance_curve.is_valid() && distance_curve->is_connected("changed", changed)) {
+    distance_curve->disconnect("changed", changed);
   }
+  distance_curve = p_curve;
+  if (distance_curve.is_valid()) {
+    distance_curve->connect("changed", changed);
+  }
+  UpdateDistanceCurve();
+}
 
-  if (!resonance_audio_copy->api->FillInterleavedOutputBuffer(
-          kNumOutputChannels, num_frames, output)) {
-    // No valid output was rendered, fill the output buffer with zeros.
-    const size_t buffer_size_samples = kNumOutputChannels * num_frames;
-    CHECK(!vraudio::DoesIntegerMultiplicationOverflow<size_t>(
-        kNumOutputChannels, num_frames, buffer_size_samples));
+Ref<Curve> GDResonanceEffect::GetDistanceCurve() const {
+  return distance_curve;
+}
 
-    std::fill(output, output + buffer_size_samples, 0.0f);
+void GDResonanceEffect::UpdateDistanceCurve(){
+  DistanceCurve curve;
+  for (size_t i = 0; i < DistanceCurve::kNumPoints; i++) {
+    const float t = static_cast<float>(i) / (DistanceCurve::kNumPoints - 1);
+    curve.gains[i] = distance_curve.is_valid() ? MAX(distance_curve->sample_baked(t), 0.0f) : 1.0f - t;
   }
+  get_resonance_world(world)->SetDistanceCurve(curve);
+}
 
+void GDResonanceEffect::SetSourceTransforms(const PackedInt32Array &p_ids, const PackedFloat32Array &p_positions, const PackedFloat32Array &p_rotations){
+  const int64_t count = p_ids.size();
+  ERR_FAIL_COND_MSG(p_positions.size() != 3 * count, "set_source_transforms() takes 3 position floats per id.");
+  ERR_FAIL_COND_MSG(!p_rotations.is_empty() && p_rotations.size() != 4 * count, "set_source_transforms() takes 4 rotation floats per id, or none.");
+  get_resonance_world(world)->SetSourceTransforms(p_ids.ptr(), p_positions.ptr(), p_rotations.is_empty() ? nullptr : p_rotations.ptr(), count);
 }
 
-void GDResonance::SetListenerGain(float gain) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetMasterVolume(gain);
+void GDResonanceEffect::SetSourceGains(const PackedInt32Array &p_ids, const PackedFloat32Array &p_gains){
+  ERR_FAIL_COND_MSG(p_gains.size() != p_ids.size(), "set_source_gains() takes one gain per id.");
+  get_resonance_world(world)->SetSourceGains(p_ids.ptr(), p_gains.ptr(), p_ids.size());
+}
+
+Dictionary GDResonanceEffect::GetStats() const {
+  ResonanceStats stats;
+  get_resonance_world(world)->GetStats(&stats);
+  int sources = 0;
+  for (int i = 0; i < kNumPooledRenderingModes; i++) {
+    sources += stats.sources[i];
   }
+  Dictionary result;
+  result["blocks"] = stats.blocks;
+  result["render_time_ms"] = stats.render_time;
+  result["max_render_time_ms"] = stats.max_render_time;
+  result["peak_render_time_ms"] = stats.peak_render_time;
+  result["load"] = stats.load;
+  result["updates_per_block"] = stats.updates;
+  result["sources"] = sources;
+  result["sources_stereo_panning"] = stats.sources[vraudio::kStereoPanning];
+  result["sources_binaural_low"] = stats.sources[vraudio::kBinauralLowQuality];
+  result["sources_binaural_medium"] = stats.sources[vraudio::kBinauralMediumQuality];
+  result["sources_binaural_high"] = stats.sources[vraudio::kBinauralHighQuality];
+  result["soundfields"] = stats.soundfields;
+  result["virtual_sources"] = stats.virtual_sources;
+  result["silent_sources"] = stats.silent_sources;
+  result["idle"] = stats.idle;
+  result["idle_time"] = stats.idle_time;
+  result["total_blocks"] = static_cast<int64_t>(stats.total_blocks);
+  result["late_blocks"] = static_cast<int64_t>(stats.late_blocks);
+  result["underruns"] = static_cast<int64_t>(stats.underruns);
+  result["dropped_updates"] = static_cast<int64_t>(stats.dropped_updates);
+  result["late_updates"] = static_cast<int64_t>(stats.late_updates);
+  return result;
 }
 
-void GDResonance::SetListenerStereoSpeakerMode(bool enable_stereo_speaker_mode) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetStereoSpeakerMode(enable_stereo_speaker_mode);
+Variant GDResonanceEffect::GetMonitor(const String &p_key) const {
+  return GetStats()[p_key];
+}
+
+// Entries of GetStats() shown in the debugger's monitors, under
+// GDResonance/<world>/.
+static const char *const kMonitorKeys[] = {
+    "render_time_ms", "max_render_time_ms", "load", "sources", "virtual_sources",
+    "idle_time", "underruns", "late_blocks", "dropped_updates",
+};
+
+void GDResonanceEffect::AddMonitors() {
+  const String name = String(world).is_empty() ? String("default") : String(world);
+  if (name == monitor_world) {
+    return;
+  }
+  RemoveMonitors();
+  Performance *performance = Performance::get_singleton();
+  const String prefix = "GDResonance/" + name + "/";
+  if (performance->has_custom_monitor(prefix + kMonitorKeys[0])) {
+    // Another effect of the same world reports it already.
+    return;
+  }
+  for (const char *key : kMonitorKeys) {
+    Array arguments;
+    arguments.push_back(String(key));
+    performance->add_custom_monitor(prefix + key, Callable(this, "_get_monitor"), arguments);
+  }
+  monitor_world = name;
+}
+
+void GDResonanceEffect::RemoveMonitors() {
+  if (monitor_world.is_empty()) {
+    return;
+  }
+  Performance *performance = Performance::get_singleton();
+  const String prefix = "GDResonance/" + monitor_world + "/";
+  for (const char *key : kMonitorKeys) {
+    if (performance->has_custom_monitor(prefix + key)) {
+      performance->remove_custom_monitor(prefix + key);
+    }
   }
+  monitor_world = String();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//Resonance
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+
+void GDResonance::Initialize(int sample_rate, size_t num_channels, size_t frames_per_buffer) {
+  world->Initialize(sample_rate, num_channels, frames_per_buffer);
+}
+
+void GDResonance::Shutdown() { world->Shutdown(); }
+
+void GDResonance::ProcessListener(size_t num_frames, float* output) {
+  world->Render(num_frames, output);
+}
+
+void GDResonance::SetListenerGain(float gain) {
+  world->SetListenerGain(gain);
+}
+
+void GDResonance::SetListenerStereoSpeakerMode(bool enable_stereo_speaker_mode) {
+  world->SetListenerStereoSpeakerMode(enable_stereo_speaker_mode);
 }
 
 void GDResonance::SetListenerTransform(float px, float py, float pz, float qx, float qy,
                           float qz, float qw) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetHeadPosition(px, py, pz);
-    resonance_audio_copy->api->SetHeadRotation(qx, qy, qz, qw);
-  }
+  world->SetListenerTransform(px, py, pz, qx, qy, qz, qw);
 }
 
-vraudio::ResonanceAudioApi::SourceId GDResonance::CreateSoundfield(int num_channels) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    return resonance_audio_copy->api->CreateAmbisonicSource(num_channels);
-  }
-  return vraudio::ResonanceAudioApi::kInvalidSourceId;
+ResonanceWorld::SourceHandle GDResonance::CreateSoundfield(int num_channels) {
+  return world->AddSoundfield(num_channels);
 }
 
-vraudio::ResonanceAudioApi::SourceId GDResonance::CreateSoundObject(vraudio::RenderingMode rendering_mode) {
-  vraudio::SourceId id = vraudio::ResonanceAudioApi::kInvalidSourceId;
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    id = resonance_audio_copy->api->CreateSoundObjectSource(rendering_mode);
-    resonance_audio_copy->api->SetSourceDistanceModel(
-        id, vraudio::DistanceRolloffModel::kNone, 0.0f, 0.0f);
-  }
-  return id;
+ResonanceWorld::SourceHandle GDResonance::CreateSoundObject(vraudio::RenderingMode rendering_mode) {
+  return world->AddSource(rendering_mode);
 }
 
-void GDResonance::DestroySource(vraudio::ResonanceAudioApi::SourceId id) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->DestroySource(id);
-  }
+void GDResonance::DestroySource(ResonanceWorld::SourceHandle id) {
+  world->RemoveSource(id);
 }
 
-void GDResonance::ProcessSource(vraudio::ResonanceAudioApi::SourceId id, size_t num_channels,
+void GDResonance::ProcessSource(ResonanceWorld::SourceHandle id, size_t num_channels,
                    size_t num_frames, float* input) {
   CHECK(input != nullptr);
-
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetInterleavedBuffer(id, input, num_channels,
-                                                    num_frames);
-  }
+  world->PushInput(id, input, num_frames);
 }
 
-void GDResonance::SetSourceDirectivity(vraudio::ResonanceAudioApi::SourceId id, float alpha,
+void GDResonance::SetSourceDirectivity(ResonanceWorld::SourceHandle id, float alpha,
                           float order) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSoundObjectDirectivity(id, alpha, order);
-  }
+  world->SetSourceDirectivity(id, alpha, order);
 }
 
-void GDResonance::SetSourceDistanceAttenuation(vraudio::ResonanceAudioApi::SourceId id,
+void GDResonance::SetSourceDistanceAttenuation(ResonanceWorld::SourceHandle id,
                                   float distance_attenuation) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSourceDistanceAttenuation(
-        id, distance_attenuation);
-  }
+  world->SetSourceDistanceAttenuation(id, distance_attenuation);
 }
 
-void GDResonance::SetSourceGain(vraudio::ResonanceAudioApi::SourceId id, float gain) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSourceVolume(id, gain);
-  }
+void GDResonance::SetSourceGain(ResonanceWorld::SourceHandle id, float gain) {
+  world->SetSourceGain(id, gain);
 }
 
-void GDResonance::SetSourceListenerDirectivity(vraudio::ResonanceAudioApi::SourceId id, float alpha,
+void GDResonance::SetSourceListenerDirectivity(ResonanceWorld::SourceHandle id, float alpha,
                                   float order) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSoundObjectListenerDirectivity(id, alpha,
-                                                                 order);
-  }
+  world->SetSourceListenerDirectivity(id, alpha, order);
 }
 
-void GDResonance::SetSourceNearFieldEffectGain(vraudio::ResonanceAudioApi::SourceId id,
+void GDResonance::SetSourceNearFieldEffectGain(ResonanceWorld::SourceHandle id,
                                   float near_field_effect_gain) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSoundObjectNearFieldEffectGain(
-        id, near_field_effect_gain);
-  }
+  world->SetSourceNearFieldEffectGain(id, near_field_effect_gain);
 }
 
-void GDResonance::SetSourceOcclusionIntensity(vraudio::ResonanceAudioApi::SourceId id,
+void GDResonance::SetSourceOcclusionIntensity(ResonanceWorld::SourceHandle id,
                                  float intensity) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSoundObjectOcclusionIntensity(id, intensity);
-  }
+  world->SetSourceOcclusionIntensity(id, intensity);
 }
 
-void GDResonance::SetSourceRoomEffectsGain(vraudio::ResonanceAudioApi::SourceId id,
+void GDResonance::SetSourceRoomEffectsGain(ResonanceWorld::SourceHandle id,
                               float room_effects_gain) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSourceRoomEffectsGain(id, room_effects_gain);
-  }
+  world->SetSourceRoomEffectsGain(id, room_effects_gain);
 }
 
-void GDResonance::SetSourceSpread(int id, float spread_deg) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSoundObjectSpread(id, spread_deg);
-  }
+void GDResonance::SetSourceSpread(ResonanceWorld::SourceHandle id, float spread_deg) {
+  world->SetSourceSpread(id, spread_deg);
 }
 
-void GDResonance::SetSourceTransform(int id, float px, float py, float pz, float qx,
+void GDResonance::SetSourceTransform(ResonanceWorld::SourceHandle id, float px, float py, float pz, float qx,
                         float qy, float qz, float qw) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy != nullptr) {
-    resonance_audio_copy->api->SetSourcePosition(id, px, py, pz);
-    resonance_audio_copy->api->SetSourceRotation(id, qx, qy, qz, qw);
-  }
+  world->SetSourceTransform(id, px, py, pz, qx, qy, qz, qw);
 }
 
 void GDResonance::SetRoomProperties(vraudio::RoomProperties* room_properties, float* rt60s) {
-  auto resonance_audio_copy = resonance_audio;
-  if (resonance_audio_copy == nullptr) {
-    return;
-  }
-  if (room_properties == nullptr) {
-    resonance_audio_copy->api->SetReflectionProperties(
-        resonance_audio_copy->null_reflection_properties);
-    resonance_audio_copy->api->SetReverbProperties(
-        resonance_audio_copy->null_reverb_properties);
-    return;
-  }
-
-  const auto reflection_properties =
-      ComputeReflectionProperties(*room_properties);
-  resonance_audio_copy->api->SetReflectionProperties(reflection_properties);
-  const auto reverb_properties =
-      (rt60s == nullptr)
-          ? ComputeReverbProperties(*room_properties)
-          : vraudio::ComputeReverbPropertiesFromRT60s(
-                rt60s, room_properties->reverb_brightness,
-                room_properties->reverb_time, room_properties->reverb_gain);
-  resonance_audio_copy->api->SetReverbProperties(reverb_properties);
+  world->SetRoomProperties(room_properties, rt60s);
 }
 
 void GDResonance::UpdatePosition(float x, float y, float z){
-  SetSourceTransform(mId1, x, y, z, 1.0f, 0.0f, 0.0f, 0.0f);
+  // Called from _process on the audio thread, which owns the graph, so the
+  // update skips the game thread command queue.
+  const ResonanceCommand command = {ResonanceCommand::kSourceTransform, bus_source,
+                                    {x, y, z, 1.0f, 0.0f, 0.0f, 0.0f}};
+  world->Apply(command);
 }
 
 void GDResonance::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("_rebuild_graph"), &GDResonance::RebuildGraph);
 }
 
 GDResonance::GDResonance() {
     // Initialize any variables here.
-    Initialize(kSampleRate,2,nFrames);
-    SetListenerGain(1.0f);
-    SetListenerTransform(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
-    mId1 = CreateSoundObject(vraudio::RenderingMode::kBinauralHighQuality);
-    //mId2 = CreateSoundObject(vraudio::RenderingMode::kBinauralHighQuality);
+    world = nullptr;
+    bus_source = ResonanceWorld::kInvalidSourceHandle;
+    bus_position_valid = false;
+    graph_rate = 0;
+    rebuild_pending = false;
+    input_buffer.resize(nFrames);
+    if (!kInterleavedAudioFrame) {
+      output_buffer.resize(nFrames * kNumOutputChannels);
+    }
 }
 
 GDResonance::~GDResonance() {
     // Add your cleanup here.
-    Shutdown();
+    if (world == nullptr) {
+      return;
+    }
+    DestroySource(bus_source);
+    if (world->DetachRenderer(this)) {
+      Shutdown();
+    }
 }
 
-/*void GDResonance::_process() {
+void GDResonance::Attach(ResonanceWorld *p_world) {
+  world = p_world;
+  if (world->AttachRenderer(this)) {
+    Initialize(get_mix_rate(),2,nFrames);
+    SetListenerGain(1.0f);
+    SetListenerTransform(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+  }
+  graph_rate = world->sample_rate();
+  bus_source = CreateSoundObject(vraudio::RenderingMode::kBinauralHighQuality);
+}
 
-}*/ 
-float angle1 = 0.0f;
-float angle2 = 0.0f;
+void GDResonance::RebuildGraph() {
+  rebuild_pending = false;
+  if (world == nullptr || !world->IsRenderer(this)) {
+    return;
+  }
+  // The current graph keeps rendering while the new one is built.
+  graph_rate = get_mix_rate();
+  Initialize(graph_rate, 2, nFrames);
+}
 
 void GDResonance::_process(godot::AudioFrame *src_buffer, godot::AudioFrame *dst_buffer, int32_t frame_count) {
 
-  px1 = 10.0f * cos(angle1);
-  //px1 = base->py;
- 
-  py1 = 10.0f * sin(angle1);
-  //py1 = base->py;
-  
-  pz1 = 10.0f * sin(angle1);
-  //pz1 = base->pz;
-
-  /*float px = base->px;
-  float py = base->py;
-  float pz = base->pz;*/
+  if (world == nullptr) {
+    for (int32_t i = 0; i < frame_count; i++) {
+      dst_buffer[i].left = 0.0f;
+      dst_buffer[i].right = 0.0f;
+    }
+    return;
+  }
 
+  // Every bus of the world is one more source; everything else arrives
+  // through the input rings of the registered GDResonanceSource nodes. All
+  // buses run on the same mix thread, so the bus source is fed even when
+  // another instance renders the world. A silent bus is not queued at all,
+  // unless earlier input is still queued and the silence keeps its timing.
+  const Vector3 position(base->px, base->py, base->pz);
+  if (!bus_position_valid || position != bus_position) {
+    UpdatePosition(position.x, position.y, position.z);
+    bus_position = position;
+    bus_position_valid = true;
+  }
+  bool bus_silent = world->GetInputSpace(bus_source) == ResonanceWorld::kInputRingFrames;
+  for (int32_t offset = 0; bus_silent && offset < frame_count; offset += nFrames) {
+    const int32_t frames = std::min<int32_t>(nFrames, frame_count - offset);
+    const float *src = interleaved_frames(src_buffer + offset, frames, output_buffer.data());
+    bus_silent = PeakLevel(src, 2 * frames) < ResonanceWorld::kSilenceThreshold;
+  }
+  for (int32_t offset = 0; !bus_silent && offset < frame_count; offset += nFrames) {
+    const int32_t frames = std::min<int32_t>(nFrames, frame_count - offset);
+    const float *src = interleaved_frames(src_buffer + offset, frames, output_buffer.data());
+    DownmixStereo(src, frames, input_buffer.data());
+    ProcessSource(bus_source, 1, frames, input_buffer.data());
+  }
 
+  if (!world->IsRenderer(this)) {
+    // Another effect instance renders this world, this bus included.
+    for (int32_t i = 0; i < frame_count; i++) {
+      dst_buffer[i].left = 0.0f;
+      dst_buffer[i].right = 0.0f;
+    }
+    return;
+  }
 
-  //UpdatePosition(px1, py1, pz1);
-  UpdatePosition(px, py, pz);
+  if (get_mix_rate() != graph_rate.load(std::memory_order_relaxed) &&
+      !rebuild_pending.exchange(true)) {
+    // The output device changed. Building a graph allocates, so it is left
+    // to the main thread.
+    call_deferred("_rebuild_graph");
+  }
 
-  //SetSourceTransform(mId1, px, py, pz, 1.0f, 0.0f, 0.0f, 0.0f); //doesn't want to do this ;(
+  if (kInterleavedAudioFrame) {
+    // The graph writes its interleaved output straight into the bus buffer.
+    ProcessListener(frame_count, reinterpret_cast<float *>(dst_buffer));
+    return;
+  }
 
-  for (int i = 0; i < frame_count; i++) {
-		inp1[i] = src_buffer[i].left;
+  for (int32_t offset = 0; offset < frame_count; offset += nFrames) {
+    const int32_t frames = std::min<int32_t>(nFrames, frame_count - offset);
+    AudioFrame *dst = dst_buffer + offset;
+    ProcessListener(frames, output_buffer.data());
+    for (int32_t i = 0; i < frames; i++) {
+      dst[i].left = output_buffer[2 * i];
+      dst[i].right = output_buffer[2 * i + 1];
+    }
   }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//Send
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  ProcessSource(mId1, 1, frame_count, inp1);
-  ProcessListener(frame_count, out);
-  
+Ref<AudioEffectInstance> GDResonanceSendEffect::_instantiate(){
+  Ref<GDResonanceSend> ins;
+	ins.instantiate();
+	ins->base = Ref<GDResonanceSendEffect>(this);
+	return ins;
+}
 
-  for (int i = 0; i < frame_count*2; i+=2) {
-    dst_buffer[i/2].left = out[i];
-		dst_buffer[i/2].right = out[i+1];
+void GDResonanceSendEffect::_bind_methods() {
+}
+
+GDResonanceSendEffect::GDResonanceSendEffect() {
+    // Initialize any variables here.
+    world = nullptr;
+    source = ResonanceWorld::kInvalidSourceHandle;
+    source_right = ResonanceWorld::kInvalidSourceHandle;
+}
+
+GDResonanceSendEffect::~GDResonanceSendEffect() {
+    // Add your cleanup here.
+}
+
+void GDResonanceSendEffect::SetSource(ResonanceWorld *p_world, ResonanceWorld::SourceHandle handle,
+                                      ResonanceWorld::SourceHandle right_handle){
+  // The handle is published last, so a valid handle always comes with its world
+  // and right channel.
+  source.store(ResonanceWorld::kInvalidSourceHandle, std::memory_order_release);
+  world.store(p_world, std::memory_order_release);
+  source_right.store(right_handle, std::memory_order_release);
+  source.store(handle, std::memory_order_release);
+}
+
+ResonanceWorld::SourceHandle GDResonanceSendEffect::GetSource() const {
+  return source.load(std::memory_order_acquire);
+}
+
+ResonanceWorld::SourceHandle GDResonanceSendEffect::GetSourceRight() const {
+  return source_right.load(std::memory_order_acquire);
+}
+
+ResonanceWorld *GDResonanceSendEffect::GetResonanceWorld() const {
+  return world.load(std::memory_order_acquire);
+}
+
+void GDResonanceSend::_bind_methods() {
+}
+
+GDResonanceSend::GDResonanceSend() {
+    // Initialize any variables here.
+    // Mono downmix or left channel, followed by the right channel and, for
+    // AudioFrame layouts that cannot be read in place, the interleaved copy.
+    input_buffer.resize(kInterleavedAudioFrame ? nFrames * 2 : nFrames * 4);
+}
+
+GDResonanceSend::~GDResonanceSend() {
+    // Add your cleanup here.
+}
+
+void GDResonanceSend::_process(godot::AudioFrame *src_buffer, godot::AudioFrame *dst_buffer, int32_t frame_count) {
+  const ResonanceWorld::SourceHandle handle = base->GetSource();
+  const ResonanceWorld::SourceHandle right_handle = base->GetSourceRight();
+  ResonanceWorld *world = base->GetResonanceWorld();
+
+  if (handle != ResonanceWorld::kInvalidSourceHandle) {
+    float *left = input_buffer.data();
+    float *right = left + nFrames;
+    for (int32_t offset = 0; offset < frame_count; offset += nFrames) {
+      const int32_t frames = std::min<int32_t>(nFrames, frame_count - offset);
+      const float *src = interleaved_frames(src_buffer + offset, frames, right + nFrames);
+      if (right_handle == ResonanceWorld::kInvalidSourceHandle) {
+        DownmixStereo(src, frames, left);
+        world->PushInput(handle, left, frames);
+      } else {
+        DeinterleaveStereo(src, frames, left, right);
+        world->PushInput(handle, left, frames);
+        world->PushInput(right_handle, right, frames);
+      }
+    }
+  }
+
+  // The dry signal is consumed here; it reaches the listener spatialized.
+  for (int i = 0; i < frame_count; i++) {
+    dst_buffer[i].left = 0.0f;
+    dst_buffer[i].right = 0.0f;
   }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pose
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  angle1 += 0.01;
-  if(angle1 > 360.0f){
-    angle1 = 0.0f;
+bool ResonancePose::Update(const Transform3D &transform) {
+  const Vector3 new_position = transform.origin;
+  const Quaternion new_rotation = transform.basis.get_rotation_quaternion();
+  if (valid && position.distance_squared_to(new_position) < kPositionThreshold * kPositionThreshold &&
+      1.0f - Math::abs(rotation.dot(new_rotation)) < kRotationThreshold) {
+    return false;
   }
+  position = new_position;
+  rotation = new_rotation;
+  valid = true;
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -373,59 +771,1033 @@ void GDResonance::_process(godot::AudioFrame *src_buffer, godot::AudioFrame *dst
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void GDResonanceListener::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("set_world", "world"), &GDResonanceListener::SetWorld);
+  ClassDB::bind_method(D_METHOD("get_world"), &GDResonanceListener::GetWorld);
+  ClassDB::bind_method(D_METHOD("set_occlusion", "occlusion"), &GDResonanceListener::SetOcclusion);
+  ClassDB::bind_method(D_METHOD("get_occlusion"), &GDResonanceListener::GetOcclusion);
+  ClassDB::bind_method(D_METHOD("set_occlusion_rays_per_frame", "rays"), &GDResonanceListener::SetOcclusionRaysPerFrame);
+  ClassDB::bind_method(D_METHOD("get_occlusion_rays_per_frame"), &GDResonanceListener::GetOcclusionRaysPerFrame);
+  ClassDB::bind_method(D_METHOD("set_occlusion_collision_mask", "mask"), &GDResonanceListener::SetOcclusionCollisionMask);
+  ClassDB::bind_method(D_METHOD("get_occlusion_collision_mask"), &GDResonanceListener::GetOcclusionCollisionMask);
+  ClassDB::bind_method(D_METHOD("set_occlusion_intensity", "intensity"), &GDResonanceListener::SetOcclusionIntensity);
+  ClassDB::bind_method(D_METHOD("get_occlusion_intensity"), &GDResonanceListener::GetOcclusionIntensity);
+  ClassDB::bind_method(D_METHOD("set_occlusion_smoothing", "smoothing"), &GDResonanceListener::SetOcclusionSmoothing);
+  ClassDB::bind_method(D_METHOD("get_occlusion_smoothing"), &GDResonanceListener::GetOcclusionSmoothing);
+
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::STRING_NAME, "world"), "set_world", "get_world");
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::BOOL, "occlusion"), "set_occlusion", "get_occlusion");
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::INT, "occlusion_rays_per_frame", PROPERTY_HINT_RANGE, "1,1024"), "set_occlusion_rays_per_frame", "get_occlusion_rays_per_frame");
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::INT, "occlusion_collision_mask", PROPERTY_HINT_LAYERS_3D_PHYSICS), "set_occlusion_collision_mask", "get_occlusion_collision_mask");
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::FLOAT, "occlusion_intensity", PROPERTY_HINT_RANGE, "0.0,4.0,0.01"), "set_occlusion_intensity", "get_occlusion_intensity");
+  ClassDB::add_property("GDResonanceListener", PropertyInfo(Variant::FLOAT, "occlusion_smoothing", PROPERTY_HINT_RANGE, "0.0,2.0,0.01,suffix:s"), "set_occlusion_smoothing", "get_occlusion_smoothing");
 }
 
 GDResonanceListener::GDResonanceListener() {
     // Initialize any variables here.
-    resonance_audio = 0.0;
+    resonance_world = nullptr;
+    occlusion = false;
+    occlusion_rays_per_frame = 32;
+    occlusion_collision_mask = 1;
+    occlusion_intensity = 1.0f;
+    occlusion_smoothing = 0.15f;
+    occlusion_query.instantiate();
+    occlusion_cursor = ResonanceWorld::kInvalidSourceHandle;
+    // Never 1, so that no source counts as seen on the previous frame.
+    occlusion_frame = 1;
+    occlusion_states.resize(ResonanceWorld::kMaxSources, OcclusionState());
+    occlusion_handles.reserve(ResonanceWorld::kMaxSources);
+    occlusion_values.reserve(ResonanceWorld::kMaxSources);
 }
 
 GDResonanceListener::~GDResonanceListener() {
     // Add your cleanup here.
 }
 
+void GDResonanceListener::SetWorld(const StringName &p_world){
+  if (is_inside_tree()) {
+    ResetOcclusion();
+  }
+  world = p_world;
+  if (is_inside_tree()) {
+    _enter_tree();
+  }
+}
+
+StringName GDResonanceListener::GetWorld() const {
+  return world;
+}
+
+void GDResonanceListener::SetOcclusion(bool p_occlusion){
+  if (occlusion && !p_occlusion && is_inside_tree()) {
+    ResetOcclusion();
+  }
+  occlusion = p_occlusion;
+  if (is_inside_tree()) {
+    set_physics_process(occlusion);
+  }
+}
+
+bool GDResonanceListener::GetOcclusion() const {
+  return occlusion;
+}
+
+void GDResonanceListener::SetOcclusionRaysPerFrame(int p_rays){
+  occlusion_rays_per_frame = MAX(p_rays, 1);
+}
+
+int GDResonanceListener::GetOcclusionRaysPerFrame() const {
+  return occlusion_rays_per_frame;
+}
+
+void GDResonanceListener::SetOcclusionCollisionMask(uint32_t p_mask){
+  occlusion_collision_mask = p_mask;
+}
+
+uint32_t GDResonanceListener::GetOcclusionCollisionMask() const {
+  return occlusion_collision_mask;
+}
+
+void GDResonanceListener::SetOcclusionIntensity(float p_intensity){
+  occlusion_intensity = p_intensity;
+}
+
+float GDResonanceListener::GetOcclusionIntensity() const {
+  return occlusion_intensity;
+}
+
+void GDResonanceListener::SetOcclusionSmoothing(float p_smoothing){
+  occlusion_smoothing = MAX(p_smoothing, 0.0f);
+}
+
+float GDResonanceListener::GetOcclusionSmoothing() const {
+  return occlusion_smoothing;
+}
+
+void GDResonanceListener::_enter_tree() {
+  resonance_world = get_resonance_world(world);
+  pose.valid = false;
+  // Only moving listeners are processed, see _notification.
+  set_notify_transform(true);
+  set_process(true);
+  set_physics_process(occlusion);
+}
+
+void GDResonanceListener::_exit_tree() {
+  ResetOcclusion();
+}
+
+void GDResonanceListener::_notification(int p_what) {
+  if (p_what == NOTIFICATION_TRANSFORM_CHANGED) {
+    set_process(true);
+  }
+}
+
 void GDResonanceListener::_process(double delta) {
+  if (pose.Update(get_global_transform())) {
+    resonance_world->SetListenerTransform(pose.position.x, pose.position.y, pose.position.z,
+                                          pose.rotation.x, pose.rotation.y, pose.rotation.z,
+                                          pose.rotation.w);
+  }
+  // Keep processing while the listener crossfades between rooms.
+  set_process(resonance_world->UpdateRooms());
+}
+
+void GDResonanceListener::_physics_process(double delta) {
+  // Physics queries are only safe from the physics step.
+  UpdateOcclusion(delta);
+}
+
+void GDResonanceListener::UpdateOcclusion(double delta) {
+  // Smooth towards the occlusion found so far, on all sources every frame.
+  const float step = occlusion_smoothing > 0.0f
+                         ? 1.0f - std::exp(-static_cast<float>(delta) / occlusion_smoothing)
+                         : 1.0f;
+  const uint32_t previous_frame = occlusion_frame++;
+  occlusion_handles.clear();
+  occlusion_values.clear();
+  for (auto handle = resonance_world->NextSoundObject(ResonanceWorld::kInvalidSourceHandle);
+       handle != ResonanceWorld::kInvalidSourceHandle;
+       handle = resonance_world->NextSoundObject(handle)) {
+    OcclusionState &state = occlusion_states[handle];
+    if (state.seen != previous_frame) {
+      // New source, starting unoccluded.
+      state.target = state.current = state.pushed = 0.0f;
+    }
+    state.seen = occlusion_frame;
+    state.current += (state.target - state.current) * step;
+    if (std::abs(state.target - state.current) < 0.01f) {
+      state.current = state.target;
+    }
+    if (state.current != state.pushed &&
+        (std::abs(state.current - state.pushed) >= 0.01f || state.current == state.target)) {
+      state.pushed = state.current;
+      occlusion_handles.push_back(handle);
+      occlusion_values.push_back(state.current);
+    }
+  }
+  if (!occlusion_handles.empty()) {
+    resonance_world->SetSourceOcclusionIntensities(occlusion_handles.data(),
+                                                   occlusion_values.data(),
+                                                   occlusion_handles.size());
+  }
+
+  // Spend the ray budget round-robin; the new targets are smoothed towards
+  // from the next frame on.
+  PhysicsDirectSpaceState3D *space = get_world_3d()->get_direct_space_state();
+  if (space == nullptr) {
+    return;
+  }
+  const float *listener_position = resonance_world->GetListenerPosition();
+  const Vector3 listener(listener_position[0], listener_position[1], listener_position[2]);
+  const auto start = occlusion_cursor;
+  bool wrapped = false;
+  int num_rays = 0;
+  while (num_rays < occlusion_rays_per_frame) {
+    const auto handle = resonance_world->NextSoundObject(occlusion_cursor);
+    if (handle == ResonanceWorld::kInvalidSourceHandle) {
+      if (wrapped || occlusion_cursor == ResonanceWorld::kInvalidSourceHandle) {
+        break;
+      }
+      wrapped = true;
+      occlusion_cursor = ResonanceWorld::kInvalidSourceHandle;
+      continue;
+    }
+    if (wrapped && handle > start) {
+      // Every source had its rays this frame.
+      break;
+    }
+    occlusion_cursor = handle;
+    OcclusionState &state = occlusion_states[handle];
+    if (state.seen != occlusion_frame) {
+      continue;
+    }
+    const float *position = resonance_world->GetSourcePosition(handle);
+    const int occluders =
+        CountOccluders(space, listener, Vector3(position[0], position[1], position[2]),
+                       MIN(kMaxOccluders, occlusion_rays_per_frame - num_rays), &num_rays);
+    state.target = occluders * occlusion_intensity;
+  }
+}
 
-} 
+int GDResonanceListener::CountOccluders(PhysicsDirectSpaceState3D *space, const Vector3 &from,
+                                        const Vector3 &to, int max_rays, int *num_rays) {
+  // Every ray excludes the colliders hit before, so the next one finds the
+  // occluder behind them.
+  occlusion_exclude.clear();
+  occlusion_query->set_from(from);
+  occlusion_query->set_to(to);
+  occlusion_query->set_collision_mask(occlusion_collision_mask);
+  int occluders = 0;
+  for (int i = 0; i < max_rays; i++) {
+    occlusion_query->set_exclude(occlusion_exclude);
+    const Dictionary hit = space->intersect_ray(occlusion_query);
+    ++*num_rays;
+    if (hit.is_empty()) {
+      break;
+    }
+    ++occluders;
+    occlusion_exclude.push_back(hit["rid"]);
+  }
+  return occluders;
+}
+
+void GDResonanceListener::ResetOcclusion() {
+  if (resonance_world == nullptr) {
+    return;
+  }
+  occlusion_handles.clear();
+  occlusion_values.clear();
+  for (auto handle = resonance_world->NextSoundObject(ResonanceWorld::kInvalidSourceHandle);
+       handle != ResonanceWorld::kInvalidSourceHandle;
+       handle = resonance_world->NextSoundObject(handle)) {
+    OcclusionState &state = occlusion_states[handle];
+    if (state.seen == occlusion_frame && state.pushed != 0.0f) {
+      occlusion_handles.push_back(handle);
+      occlusion_values.push_back(0.0f);
+    }
+    state.target = state.current = state.pushed = 0.0f;
+  }
+  if (!occlusion_handles.empty()) {
+    resonance_world->SetSourceOcclusionIntensities(occlusion_handles.data(),
+                                                   occlusion_values.data(),
+                                                   occlusion_handles.size());
+  }
+  // Sources are picked up as new ones from here on.
+  occlusion_frame += 2;
+  occlusion_cursor = ResonanceWorld::kInvalidSourceHandle;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Source
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void GDResonanceSource::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("set_bus", "bus"), &GDResonanceSource::SetBus);
+  ClassDB::bind_method(D_METHOD("get_bus"), &GDResonanceSource::GetBus);
+  ClassDB::bind_method(D_METHOD("set_world", "world"), &GDResonanceSource::SetWorld);
+  ClassDB::bind_method(D_METHOD("get_world"), &GDResonanceSource::GetWorld);
+  ClassDB::bind_method(D_METHOD("set_gain", "gain"), &GDResonanceSource::SetGain);
+  ClassDB::bind_method(D_METHOD("get_gain"), &GDResonanceSource::GetGain);
+  ClassDB::bind_method(D_METHOD("set_priority", "priority"), &GDResonanceSource::SetPriority);
+  ClassDB::bind_method(D_METHOD("get_priority"), &GDResonanceSource::GetPriority);
+  ClassDB::bind_method(D_METHOD("set_rendering_mode", "rendering_mode"), &GDResonanceSource::SetRenderingMode);
+  ClassDB::bind_method(D_METHOD("get_rendering_mode"), &GDResonanceSource::GetRenderingMode);
+  ClassDB::bind_method(D_METHOD("set_channel_mode", "channel_mode"), &GDResonanceSource::SetChannelMode);
+  ClassDB::bind_method(D_METHOD("get_channel_mode"), &GDResonanceSource::GetChannelMode);
+  ClassDB::bind_method(D_METHOD("set_stereo_width", "stereo_width"), &GDResonanceSource::SetStereoWidth);
+  ClassDB::bind_method(D_METHOD("get_stereo_width"), &GDResonanceSource::GetStereoWidth);
+  ClassDB::bind_method(D_METHOD("set_attenuation_model", "attenuation_model"), &GDResonanceSource::SetAttenuationModel);
+  ClassDB::bind_method(D_METHOD("get_attenuation_model"), &GDResonanceSource::GetAttenuationModel);
+  ClassDB::bind_method(D_METHOD("set_min_distance", "min_distance"), &GDResonanceSource::SetMinDistance);
+  ClassDB::bind_method(D_METHOD("get_min_distance"), &GDResonanceSource::GetMinDistance);
+  ClassDB::bind_method(D_METHOD("set_max_distance", "max_distance"), &GDResonanceSource::SetMaxDistance);
+  ClassDB::bind_method(D_METHOD("get_max_distance"), &GDResonanceSource::GetMaxDistance);
+  ClassDB::bind_method(D_METHOD("set_near_field_gain", "near_field_gain"), &GDResonanceSource::SetNearFieldGain);
+  ClassDB::bind_method(D_METHOD("get_near_field_gain"), &GDResonanceSource::GetNearFieldGain);
+  ClassDB::bind_method(D_METHOD("set_stream", "stream"), &GDResonanceSource::SetStream);
+  ClassDB::bind_method(D_METHOD("get_stream"), &GDResonanceSource::GetStream);
+  ClassDB::bind_method(D_METHOD("set_autoplay", "enable"), &GDResonanceSource::SetAutoplay);
+  ClassDB::bind_method(D_METHOD("is_autoplay_enabled"), &GDResonanceSource::IsAutoplay);
+  ClassDB::bind_method(D_METHOD("play", "from_position"), &GDResonanceSource::Play, DEFVAL(0.0));
+  ClassDB::bind_method(D_METHOD("stop"), &GDResonanceSource::Stop);
+  ClassDB::bind_method(D_METHOD("is_playing"), &GDResonanceSource::IsPlaying);
+  ClassDB::bind_method(D_METHOD("get_playback_position"), &GDResonanceSource::GetPlaybackPosition);
+  ClassDB::bind_method(D_METHOD("get_source_id"), &GDResonanceSource::GetSourceId);
+
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::STRING_NAME, "bus"), "set_bus", "get_bus");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::STRING_NAME, "world"), "set_world", "get_world");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "gain", PROPERTY_HINT_RANGE, "0.0,4.0,0.01"), "set_gain", "get_gain");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "priority", PROPERTY_HINT_RANGE, "0.0,10.0,0.01"), "set_priority", "get_priority");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::INT, "rendering_mode", PROPERTY_HINT_ENUM, "Auto:-1,Stereo Panning:0,Binaural Low:1,Binaural Medium:2,Binaural High:3"), "set_rendering_mode", "get_rendering_mode");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::INT, "channel_mode", PROPERTY_HINT_ENUM, "Mono Downmix,Stereo"), "set_channel_mode", "get_channel_mode");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "stereo_width", PROPERTY_HINT_RANGE, "0.0,20.0,0.01,suffix:m"), "set_stereo_width", "get_stereo_width");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::INT, "attenuation_model", PROPERTY_HINT_ENUM, "Disabled,Logarithmic,Linear,Custom"), "set_attenuation_model", "get_attenuation_model");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "min_distance", PROPERTY_HINT_RANGE, "0.01,100.0,0.01,or_greater,suffix:m"), "set_min_distance", "get_min_distance");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "max_distance", PROPERTY_HINT_RANGE, "0.1,1000.0,0.1,or_greater,suffix:m"), "set_max_distance", "get_max_distance");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::FLOAT, "near_field_gain", PROPERTY_HINT_RANGE, "0.0,9.0,0.01"), "set_near_field_gain", "get_near_field_gain");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::OBJECT, "stream", PROPERTY_HINT_RESOURCE_TYPE, "AudioStreamWAV"), "set_stream", "get_stream");
+  ClassDB::add_property("GDResonanceSource", PropertyInfo(Variant::BOOL, "autoplay"), "set_autoplay", "is_autoplay_enabled");
+
+  BIND_ENUM_CONSTANT(CHANNEL_MODE_MONO);
+  BIND_ENUM_CONSTANT(CHANNEL_MODE_STEREO);
+  BIND_ENUM_CONSTANT(ATTENUATION_DISABLED);
+  BIND_ENUM_CONSTANT(ATTENUATION_LOGARITHMIC);
+  BIND_ENUM_CONSTANT(ATTENUATION_LINEAR);
+  BIND_ENUM_CONSTANT(ATTENUATION_CUSTOM);
 }
 
 GDResonanceSource::GDResonanceSource() {
     // Initialize any variables here.
-    resonance_audio = 0.0;
+    resonance_world = nullptr;
+    source = ResonanceWorld::kInvalidSourceHandle;
+    source_right = ResonanceWorld::kInvalidSourceHandle;
+    gain = 1.0f;
+    priority = 1.0f;
+    rendering_mode = ResonanceWorld::kRenderingModeAuto;
+    channel_mode = CHANNEL_MODE_MONO;
+    stereo_width = 1.0f;
+    attenuation_model = ATTENUATION_LOGARITHMIC;
+    min_distance = 1.0f;
+    max_distance = 500.0f;
+    near_field_gain = 0.0f;
+    autoplay = false;
+    voice = ResonanceStreamer::kInvalidVoiceHandle;
 }
 
 GDResonanceSource::~GDResonanceSource() {
     // Add your cleanup here.
 }
 
-void GDResonanceSource::_process(double delta) {
+void GDResonanceSource::BindSends(ResonanceWorld::SourceHandle handle, ResonanceWorld::SourceHandle right_handle){
+  if (clip != nullptr) {
+    // Fed by the streamer, which must be the only writer of the source.
+    return;
+  }
+  AudioServer *audio_server = AudioServer::get_singleton();
+  const int32_t bus_index = audio_server->get_bus_index(bus);
+  if (bus_index < 0) {
+    return;
+  }
+  for (int32_t i = 0; i < audio_server->get_bus_effect_count(bus_index); i++) {
+    Ref<GDResonanceSendEffect> send = audio_server->get_bus_effect(bus_index, i);
+    if (send.is_valid()) {
+      send->SetSource(resonance_world, handle, right_handle);
+    }
+  }
+}
+
+void GDResonanceSource::SetBus(const StringName &p_bus){
+  if (is_inside_tree()) {
+    BindSends(ResonanceWorld::kInvalidSourceHandle, ResonanceWorld::kInvalidSourceHandle);
+  }
+  bus = p_bus;
+  if (is_inside_tree()) {
+    BindSends(source, source_right);
+  }
+}
 
-} 
+StringName GDResonanceSource::GetBus() const {
+  return bus;
+}
+
+void GDResonanceSource::SetWorld(const StringName &p_world){
+  if (is_inside_tree()) {
+    Unregister();
+  }
+  world = p_world;
+  if (is_inside_tree()) {
+    Register();
+  }
+}
+
+StringName GDResonanceSource::GetWorld() const {
+  return world;
+}
+
+void GDResonanceSource::SetGain(float p_gain){
+  gain = p_gain;
+  if (is_inside_tree()) {
+    resonance_world->SetSourceGain(source, gain);
+    if (source_right != ResonanceWorld::kInvalidSourceHandle) {
+      resonance_world->SetSourceGain(source_right, gain);
+    }
+  }
+}
+
+float GDResonanceSource::GetGain() const {
+  return gain;
+}
+
+void GDResonanceSource::SetPriority(float p_priority){
+  priority = p_priority;
+  if (is_inside_tree()) {
+    resonance_world->SetSourcePriority(source, priority);
+    if (source_right != ResonanceWorld::kInvalidSourceHandle) {
+      resonance_world->SetSourcePriority(source_right, priority);
+    }
+  }
+}
+
+float GDResonanceSource::GetPriority() const {
+  return priority;
+}
+
+void GDResonanceSource::SetRenderingMode(int p_rendering_mode){
+  ERR_FAIL_COND_MSG(p_rendering_mode < ResonanceWorld::kRenderingModeAuto || p_rendering_mode > vraudio::kBinauralHighQuality,
+                    "Invalid rendering mode.");
+  rendering_mode = p_rendering_mode;
+  if (is_inside_tree()) {
+    resonance_world->SetSourceRenderingMode(source, rendering_mode);
+    if (source_right != ResonanceWorld::kInvalidSourceHandle) {
+      resonance_world->SetSourceRenderingMode(source_right, rendering_mode);
+    }
+  }
+}
+
+int GDResonanceSource::GetRenderingMode() const {
+  return rendering_mode;
+}
+
+void GDResonanceSource::SetChannelMode(int p_channel_mode){
+  if (is_inside_tree()) {
+    Unregister();
+  }
+  channel_mode = p_channel_mode;
+  if (is_inside_tree()) {
+    Register();
+  }
+}
+
+int GDResonanceSource::GetChannelMode() const {
+  return channel_mode;
+}
+
+void GDResonanceSource::SetStereoWidth(float p_stereo_width){
+  stereo_width = p_stereo_width;
+  if (is_inside_tree() && source_right != ResonanceWorld::kInvalidSourceHandle) {
+    resonance_world->SetSourceStereoPair(source, source_right, stereo_width);
+  }
+  if (is_inside_tree() && pose.valid) {
+    PushTransform();
+  }
+}
+
+float GDResonanceSource::GetStereoWidth() const {
+  return stereo_width;
+}
+
+void GDResonanceSource::SetAttenuationModel(int p_attenuation_model){
+  attenuation_model = p_attenuation_model;
+  if (is_inside_tree()) {
+    PushDistanceModel(source);
+    PushDistanceModel(source_right);
+  }
+}
+
+int GDResonanceSource::GetAttenuationModel() const {
+  return attenuation_model;
+}
+
+void GDResonanceSource::SetMinDistance(float p_min_distance){
+  min_distance = p_min_distance;
+  if (is_inside_tree()) {
+    PushDistanceModel(source);
+    PushDistanceModel(source_right);
+  }
+}
+
+float GDResonanceSource::GetMinDistance() const {
+  return min_distance;
+}
+
+void GDResonanceSource::SetMaxDistance(float p_max_distance){
+  max_distance = p_max_distance;
+  if (is_inside_tree()) {
+    PushDistanceModel(source);
+    PushDistanceModel(source_right);
+  }
+}
+
+float GDResonanceSource::GetMaxDistance() const {
+  return max_distance;
+}
+
+void GDResonanceSource::SetNearFieldGain(float p_near_field_gain){
+  near_field_gain = p_near_field_gain;
+  if (is_inside_tree()) {
+    resonance_world->SetSourceNearFieldEffectGain(source, near_field_gain);
+    if (source_right != ResonanceWorld::kInvalidSourceHandle) {
+      resonance_world->SetSourceNearFieldEffectGain(source_right, near_field_gain);
+    }
+  }
+}
+
+float GDResonanceSource::GetNearFieldGain() const {
+  return near_field_gain;
+}
+
+void GDResonanceSource::PushDistanceModel(ResonanceWorld::SourceHandle handle){
+  if (handle != ResonanceWorld::kInvalidSourceHandle) {
+    resonance_world->SetSourceDistanceModel(handle, attenuation_model, min_distance, max_distance);
+  }
+}
+
+void GDResonanceSource::SetStream(const Ref<AudioStream> &p_stream){
+  if (is_inside_tree()) {
+    Unregister();
+  }
+  stream = p_stream;
+  clip = decode_stream(stream);
+  if (is_inside_tree()) {
+    Register();
+  }
+}
+
+Ref<AudioStream> GDResonanceSource::GetStream() const {
+  return stream;
+}
+
+void GDResonanceSource::SetAutoplay(bool p_autoplay){
+  autoplay = p_autoplay;
+}
+
+bool GDResonanceSource::IsAutoplay() const {
+  return autoplay;
+}
+
+void GDResonanceSource::Play(double p_from_position){
+  ERR_FAIL_COND_MSG(!is_inside_tree(), "GDResonanceSource must be inside the tree to play.");
+  Stop();
+  voice = resonance_world->streamer()->Play(clip, source, source_right, p_from_position);
+}
+
+void GDResonanceSource::Stop(){
+  if (voice != ResonanceStreamer::kInvalidVoiceHandle) {
+    resonance_world->streamer()->Stop(voice);
+    voice = ResonanceStreamer::kInvalidVoiceHandle;
+  }
+}
+
+bool GDResonanceSource::IsPlaying() const {
+  return voice != ResonanceStreamer::kInvalidVoiceHandle &&
+         resonance_world->streamer()->IsPlaying(voice);
+}
+
+double GDResonanceSource::GetPlaybackPosition() const {
+  if (voice == ResonanceStreamer::kInvalidVoiceHandle) {
+    return 0.0;
+  }
+  return resonance_world->streamer()->GetPosition(voice);
+}
+
+void GDResonanceSource::Register() {
+  resonance_world = get_resonance_world(world);
+  const ResonanceWorld::SourceHandle handles[] = {
+      source = resonance_world->AddSource(vraudio::RenderingMode::kBinauralHighQuality),
+      source_right = channel_mode == CHANNEL_MODE_STEREO
+                         ? resonance_world->AddSource(vraudio::RenderingMode::kBinauralHighQuality)
+                         : ResonanceWorld::kInvalidSourceHandle};
+  for (const ResonanceWorld::SourceHandle handle : handles) {
+    if (handle == ResonanceWorld::kInvalidSourceHandle) {
+      continue;
+    }
+    resonance_world->SetSourceGain(handle, gain);
+    resonance_world->SetSourcePriority(handle, priority);
+    resonance_world->SetSourceRenderingMode(handle, rendering_mode);
+    resonance_world->SetSourceNearFieldEffectGain(handle, near_field_gain);
+    PushDistanceModel(handle);
+  }
+  if (source_right != ResonanceWorld::kInvalidSourceHandle) {
+    resonance_world->SetSourceStereoPair(source, source_right, stereo_width);
+  }
+  BindSends(source, source_right);
+  if (autoplay && clip != nullptr && !Engine::get_singleton()->is_editor_hint()) {
+    Play(0.0);
+  }
+  // Only moving sources are processed, see _notification.
+  pose.valid = false;
+  set_notify_transform(true);
+  set_process(true);
+}
+
+void GDResonanceSource::Unregister() {
+  Stop();
+  BindSends(ResonanceWorld::kInvalidSourceHandle, ResonanceWorld::kInvalidSourceHandle);
+  resonance_world->RemoveSource(source);
+  resonance_world->RemoveSource(source_right);
+  source = ResonanceWorld::kInvalidSourceHandle;
+  source_right = ResonanceWorld::kInvalidSourceHandle;
+}
+
+void GDResonanceSource::PushTransform() {
+  const Quaternion &rotation = pose.rotation;
+  if (source_right == ResonanceWorld::kInvalidSourceHandle) {
+    resonance_world->SetSourceTransform(source, pose.position.x, pose.position.y,
+                                        pose.position.z, rotation.x, rotation.y,
+                                        rotation.z, rotation.w);
+    return;
+  }
+  // The channels sit on the local x axis, left channel towards -x.
+  const Vector3 offset = rotation.xform(Vector3(0.5f * stereo_width, 0.0f, 0.0f));
+  const Vector3 left = pose.position - offset;
+  const Vector3 right = pose.position + offset;
+  resonance_world->SetSourceTransform(source, left.x, left.y, left.z, rotation.x,
+                                      rotation.y, rotation.z, rotation.w);
+  resonance_world->SetSourceTransform(source_right, right.x, right.y, right.z, rotation.x,
+                                      rotation.y, rotation.z, rotation.w);
+}
+
+ResonanceWorld::SourceHandle GDResonanceSource::GetSourceId() const {
+  return source;
+}
+
+void GDResonanceSource::_enter_tree() {
+  Register();
+}
+
+void GDResonanceSource::_exit_tree() {
+  Unregister();
+}
+
+void GDResonanceSource::_notification(int p_what) {
+  if (p_what == NOTIFICATION_TRANSFORM_CHANGED) {
+    set_process(true);
+  }
+}
+
+void GDResonanceSource::_process(double delta) {
+  // Every transform change of this frame collapses into at most one update.
+  if (pose.Update(get_global_transform())) {
+    PushTransform();
+  }
+  set_process(false);
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Room
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Names of vraudio::MaterialName in enum order.
+static const char *kMaterialHint =
+    "Transparent,Acoustic Ceiling Tiles,Brick Bare,Brick Painted,Concrete Block Coarse,"
+    "Concrete Block Painted,Curtain Heavy,Fiber Glass Insulation,Glass Thin,Glass Thick,"
+    "Grass,Linoleum On Concrete,Marble,Metal,Parquet On Concrete,Plaster Rough,"
+    "Plaster Smooth,Plywood Panel,Polished Concrete Or Tile,Sheetrock,"
+    "Water Or Ice Surface,Wood Ceiling,Wood Panel,Uniform";
+
 void GDResonanceRoom::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("set_world", "world"), &GDResonanceRoom::SetWorld);
+  ClassDB::bind_method(D_METHOD("get_world"), &GDResonanceRoom::GetWorld);
+  ClassDB::bind_method(D_METHOD("set_size", "size"), &GDResonanceRoom::SetSize);
+  ClassDB::bind_method(D_METHOD("get_size"), &GDResonanceRoom::GetSize);
+  ClassDB::bind_method(D_METHOD("set_material", "surface", "material"), &GDResonanceRoom::SetMaterial);
+  ClassDB::bind_method(D_METHOD("get_material", "surface"), &GDResonanceRoom::GetMaterial);
+  ClassDB::bind_method(D_METHOD("set_reflection_scalar", "reflection_scalar"), &GDResonanceRoom::SetReflectionScalar);
+  ClassDB::bind_method(D_METHOD("get_reflection_scalar"), &GDResonanceRoom::GetReflectionScalar);
+  ClassDB::bind_method(D_METHOD("set_reverb_gain_db", "reverb_gain_db"), &GDResonanceRoom::SetReverbGainDb);
+  ClassDB::bind_method(D_METHOD("get_reverb_gain_db"), &GDResonanceRoom::GetReverbGainDb);
+  ClassDB::bind_method(D_METHOD("set_reverb_brightness", "reverb_brightness"), &GDResonanceRoom::SetReverbBrightness);
+  ClassDB::bind_method(D_METHOD("get_reverb_brightness"), &GDResonanceRoom::GetReverbBrightness);
+  ClassDB::bind_method(D_METHOD("set_reverb_time", "reverb_time"), &GDResonanceRoom::SetReverbTime);
+  ClassDB::bind_method(D_METHOD("get_reverb_time"), &GDResonanceRoom::GetReverbTime);
+  ClassDB::bind_method(D_METHOD("set_baked_acoustics", "baked_acoustics"), &GDResonanceRoom::SetBakedAcoustics);
+  ClassDB::bind_method(D_METHOD("get_baked_acoustics"), &GDResonanceRoom::GetBakedAcoustics);
+  ClassDB::bind_method(D_METHOD("bake", "rays", "collision_mask"), &GDResonanceRoom::Bake, DEFVAL(4096), DEFVAL(static_cast<int64_t>(0xFFFFFFFF)));
+  ClassDB::bind_method(D_METHOD("is_baked"), &GDResonanceRoom::IsBaked);
+
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::STRING_NAME, "world"), "set_world", "get_world");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::VECTOR3, "size", PROPERTY_HINT_NONE, "suffix:m"), "set_size", "get_size");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "left_wall_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_LEFT_WALL);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "right_wall_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_RIGHT_WALL);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "floor_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_FLOOR);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "ceiling_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_CEILING);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "front_wall_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_FRONT_WALL);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::INT, "back_wall_material", PROPERTY_HINT_ENUM, kMaterialHint), "set_material", "get_material", SURFACE_BACK_WALL);
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::FLOAT, "reflection_scalar", PROPERTY_HINT_RANGE, "0.0,2.0,0.01"), "set_reflection_scalar", "get_reflection_scalar");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::FLOAT, "reverb_gain_db", PROPERTY_HINT_RANGE, "-24.0,24.0,0.1,suffix:dB"), "set_reverb_gain_db", "get_reverb_gain_db");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::FLOAT, "reverb_brightness", PROPERTY_HINT_RANGE, "-1.0,1.0,0.01"), "set_reverb_brightness", "get_reverb_brightness");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::FLOAT, "reverb_time", PROPERTY_HINT_RANGE, "0.0,3.0,0.01"), "set_reverb_time", "get_reverb_time");
+  ClassDB::add_property("GDResonanceRoom", PropertyInfo(Variant::STRING, "baked_acoustics", PROPERTY_HINT_FILE, "*.bake"), "set_baked_acoustics", "get_baked_acoustics");
+
+  BIND_ENUM_CONSTANT(SURFACE_LEFT_WALL);
+  BIND_ENUM_CONSTANT(SURFACE_RIGHT_WALL);
+  BIND_ENUM_CONSTANT(SURFACE_FLOOR);
+  BIND_ENUM_CONSTANT(SURFACE_CEILING);
+  BIND_ENUM_CONSTANT(SURFACE_FRONT_WALL);
+  BIND_ENUM_CONSTANT(SURFACE_BACK_WALL);
 }
 
 GDResonanceRoom::GDResonanceRoom() {
     // Initialize any variables here.
-    resonance_audio = 0.0;
+    resonance_world = nullptr;
+    room = ResonanceWorld::kInvalidRoomHandle;
+    baked = nullptr;
+    baked_key = 0;
+    size = Vector3(10.0f, 3.0f, 10.0f);
+    for (size_t i = 0; i < vraudio::kNumRoomSurfaces; i++) {
+      materials[i] = vraudio::kConcreteBlockCoarse;
+    }
+    materials[SURFACE_FLOOR] = vraudio::kParquetOnConcrete;
+    materials[SURFACE_CEILING] = vraudio::kPlasterRough;
+    reflection_scalar = 1.0f;
+    reverb_gain_db = 0.0f;
+    reverb_brightness = 0.0f;
+    reverb_time = 1.0f;
+    dirty = false;
 }
 
 GDResonanceRoom::~GDResonanceRoom() {
     // Add your cleanup here.
 }
 
-void GDResonanceRoom::_process(double delta) {
+void GDResonanceRoom::MarkDirty() {
+  dirty = true;
+  if (is_inside_tree()) {
+    set_process(true);
+  }
+}
+
+void GDResonanceRoom::SetWorld(const StringName &p_world){
+  if (is_inside_tree()) {
+    resonance_world->RemoveRoom(room);
+    resonance_world->UpdateRooms();
+    resonance_world = get_resonance_world(p_world);
+    room = resonance_world->AddRoom();
+  }
+  world = p_world;
+  MarkDirty();
+}
+
+StringName GDResonanceRoom::GetWorld() const {
+  return world;
+}
+
+void GDResonanceRoom::SetSize(const Vector3 &p_size){
+  size = p_size;
+  MarkDirty();
+}
+
+Vector3 GDResonanceRoom::GetSize() const {
+  return size;
+}
+
+void GDResonanceRoom::SetMaterial(int p_surface, int p_material){
+  ERR_FAIL_INDEX(p_surface, static_cast<int>(vraudio::kNumRoomSurfaces));
+  materials[p_surface] = CLAMP(p_material, 0, static_cast<int>(vraudio::kNumMaterialNames) - 1);
+  MarkDirty();
+}
+
+int GDResonanceRoom::GetMaterial(int p_surface) const {
+  ERR_FAIL_INDEX_V(p_surface, static_cast<int>(vraudio::kNumRoomSurfaces), 0);
+  return materials[p_surface];
+}
+
+void GDResonanceRoom::SetReflectionScalar(float p_reflection_scalar){
+  reflection_scalar = p_reflection_scalar;
+  MarkDirty();
+}
+
+float GDResonanceRoom::GetReflectionScalar() const {
+  return reflection_scalar;
+}
+
+void GDResonanceRoom::SetReverbGainDb(float p_reverb_gain_db){
+  reverb_gain_db = p_reverb_gain_db;
+  MarkDirty();
+}
+
+float GDResonanceRoom::GetReverbGainDb() const {
+  return reverb_gain_db;
+}
+
+void GDResonanceRoom::SetReverbBrightness(float p_reverb_brightness){
+  reverb_brightness = p_reverb_brightness;
+  MarkDirty();
+}
+
+float GDResonanceRoom::GetReverbBrightness() const {
+  return reverb_brightness;
+}
+
+void GDResonanceRoom::SetReverbTime(float p_reverb_time){
+  reverb_time = p_reverb_time;
+  MarkDirty();
+}
+
+float GDResonanceRoom::GetReverbTime() const {
+  return reverb_time;
+}
+
+void GDResonanceRoom::SetBakedAcoustics(const String &p_baked_acoustics){
+  baked_acoustics = p_baked_acoustics;
+  if (is_inside_tree()) {
+    LoadBakedAcoustics();
+  }
+}
 
+String GDResonanceRoom::GetBakedAcoustics() const {
+  return baked_acoustics;
+}
+
+String GDResonanceRoom::GetBakeName() const {
+  const Node *scene = get_owner();
+  return scene != nullptr ? String(scene->get_path_to(this)) : String(get_name());
+}
+
+// Baked acoustics asset, shared by all rooms of the same file so that Bake()
+// can unmap it for every one of them before replacing the file. Main thread
+// only.
+struct SharedBakedAcoustics {
+  std::string path;
+  BakedAcoustics asset;
+  int rooms;
+};
+
+static std::map<std::string, std::unique_ptr<SharedBakedAcoustics>> baked_assets;
+
+// Maps the asset at |shared->path|, or reads it from |file| when it cannot be
+// mapped, as inside an exported pack.
+static void load_baked_acoustics(SharedBakedAcoustics *shared, const String &file) {
+  shared->asset.Release();
+  if (!FileAccess::file_exists(file) || shared->asset.Map(shared->path)) {
+    return;
+  }
+  const PackedByteArray data = FileAccess::get_file_as_bytes(file);
+  if (!shared->asset.Load(data.ptr(), data.size())) {
+    ERR_PRINT("Not a baked acoustics file: " + file);
+  }
+}
+
+static SharedBakedAcoustics *acquire_baked_acoustics(const String &file) {
+  const std::string path = ProjectSettings::get_singleton()->globalize_path(file).utf8().get_data();
+  std::unique_ptr<SharedBakedAcoustics> &shared = baked_assets[path];
+  if (shared == nullptr) {
+    shared.reset(new SharedBakedAcoustics());
+    shared->path = path;
+    shared->rooms = 0;
+    load_baked_acoustics(shared.get(), file);
+  }
+  shared->rooms++;
+  return shared.get();
+}
+
+static void release_baked_acoustics(SharedBakedAcoustics *shared) {
+  if (--shared->rooms == 0) {
+    baked_assets.erase(shared->path);
+  }
+}
+
+void GDResonanceRoom::LoadBakedAcoustics(){
+  ReleaseBakedAcoustics();
+  if (!baked_acoustics.is_empty()) {
+    baked = acquire_baked_acoustics(baked_acoustics);
+    baked_key = BakeKey(GetBakeName().utf8().get_data());
+  }
+  MarkDirty();
+}
+
+void GDResonanceRoom::ReleaseBakedAcoustics(){
+  if (baked != nullptr) {
+    release_baked_acoustics(baked);
+    baked = nullptr;
+  }
+}
+
+const BakedRoom *GDResonanceRoom::GetBakedRoom() const {
+  return baked != nullptr ? baked->asset.Find(baked_key) : nullptr;
+}
+
+// Scene seen by the rays of GDResonanceRoom::Bake().
+struct RoomBakeScene {
+  PhysicsDirectSpaceState3D *space;
+  Ref<PhysicsRayQueryParameters3D> query;
+  // Rotates world directions into the room, to tell which surface a hit faces.
+  Quaternion to_room;
+  const int *materials;
+};
+
+// BakeRayFn of GDResonanceRoom::Bake().
+static bool cast_bake_ray(void *context, const float *origin, const float *direction,
+                          float max_distance, BakeHit *hit) {
+  RoomBakeScene *scene = static_cast<RoomBakeScene *>(context);
+  const Vector3 from(origin[0], origin[1], origin[2]);
+  scene->query->set_from(from);
+  scene->query->set_to(from + Vector3(direction[0], direction[1], direction[2]) * max_distance);
+  const Dictionary result = scene->space->intersect_ray(scene->query);
+  if (result.is_empty()) {
+    return false;
+  }
+  const Vector3 position = result["position"];
+  const Vector3 normal = result["normal"];
+  hit->distance = (position - from).length();
+  hit->normal[0] = normal.x;
+  hit->normal[1] = normal.y;
+  hit->normal[2] = normal.z;
+
+  int material = -1;
+  Object *collider = result["collider"];
+  if (collider != nullptr && collider->has_meta("resonance_material")) {
+    material = collider->get_meta("resonance_material");
+  }
+  if (material < 0 || material >= static_cast<int>(vraudio::kNumMaterialNames)) {
+    // The surface whose inward normal is closest to the one hit.
+    const Vector3 local = scene->to_room.xform(normal);
+    const Vector3 extent = local.abs();
+    int surface;
+    if (extent.x >= extent.y && extent.x >= extent.z) {
+      surface = local.x > 0.0f ? GDResonanceRoom::SURFACE_LEFT_WALL : GDResonanceRoom::SURFACE_RIGHT_WALL;
+    } else if (extent.y >= extent.z) {
+      surface = local.y > 0.0f ? GDResonanceRoom::SURFACE_FLOOR : GDResonanceRoom::SURFACE_CEILING;
+    } else {
+      surface = local.z > 0.0f ? GDResonanceRoom::SURFACE_FRONT_WALL : GDResonanceRoom::SURFACE_BACK_WALL;
+    }
+    material = scene->materials[surface];
+  }
+  const vraudio::RoomMaterial room_material = vraudio::GetRoomMaterial(material);
+  std::copy(room_material.absorption_coefficients,
+            room_material.absorption_coefficients + vraudio::kNumReverbOctaveBands, hit->absorption);
+  return true;
+}
+
+bool GDResonanceRoom::Bake(int p_rays, int64_t p_collision_mask){
+  ERR_FAIL_COND_V_MSG(!is_inside_tree(), false, "GDResonanceRoom can only bake inside the scene tree.");
+  ERR_FAIL_COND_V_MSG(baked_acoustics.is_empty(), false, "Set baked_acoustics to the file to bake into.");
+  PhysicsDirectSpaceState3D *space = get_world_3d()->get_direct_space_state();
+  ERR_FAIL_NULL_V(space, false);
+
+  RoomBakeScene scene;
+  scene.space = space;
+  scene.query.instantiate();
+  scene.query->set_collision_mask(static_cast<uint32_t>(p_collision_mask));
+  scene.to_room = get_global_transform().basis.get_rotation_quaternion().inverse();
+  scene.materials = materials;
+  BakeSettings settings;
+  settings.num_rays = MAX(p_rays, 1);
+  const Vector3 center = get_global_position();
+  const float origin[] = {center.x, center.y, center.z};
+  // The room may have been renamed since it entered the tree.
+  baked_key = BakeKey(GetBakeName().utf8().get_data());
+  BakedRoom record;
+  record.key = baked_key;
+  ERR_FAIL_COND_V_MSG(!BakeRt60s(origin, settings, &cast_bake_ray, &scene, record.rt60s), false,
+                      "No colliders around " + GetBakeName() + " to bake.");
+
+  // The other rooms baked into the asset keep their records. No room keeps
+  // the old file mapped while it is replaced, and all of them see the new one
+  // right after.
+  std::vector<BakedRoom> rooms;
+  for (size_t i = 0; i < baked->asset.num_rooms(); i++) {
+    if (baked->asset.rooms()[i].key != record.key) {
+      rooms.push_back(baked->asset.rooms()[i]);
+    }
+  }
+  baked->asset.Release();
+  rooms.push_back(record);
+  const bool written = WriteBakedAcoustics(baked->path, rooms);
+  load_baked_acoustics(baked, baked_acoustics);
+  MarkDirty();
+  ERR_FAIL_COND_V_MSG(!written, false, "Could not write " + baked_acoustics + ".");
+  return true;
+}
+
+bool GDResonanceRoom::IsBaked() const {
+  return GetBakedRoom() != nullptr;
+}
+
+void GDResonanceRoom::_enter_tree() {
+  resonance_world = get_resonance_world(world);
+  room = resonance_world->AddRoom();
+  LoadBakedAcoustics();
+  pose.valid = false;
+  dirty = true;
+  set_notify_transform(true);
+  set_process(true);
+}
+
+void GDResonanceRoom::_exit_tree() {
+  resonance_world->RemoveRoom(room);
+  resonance_world->UpdateRooms();
+  room = ResonanceWorld::kInvalidRoomHandle;
+  ReleaseBakedAcoustics();
+}
+
+void GDResonanceRoom::_notification(int p_what) {
+  if (p_what == NOTIFICATION_TRANSFORM_CHANGED) {
+    set_process(true);
+  }
+}
+
+void GDResonanceRoom::_process(double delta) {
+  const Transform3D transform = get_global_transform();
+  // A moving room only needs new reflections; the world keeps the reverb
+  // unless the size or the surfaces changed.
+  if (pose.Update(transform) || dirty) {
+    vraudio::RoomProperties room_properties;
+    room_properties.position[0] = pose.position.x;
+    room_properties.position[1] = pose.position.y;
+    room_properties.position[2] = pose.position.z;
+    room_properties.rotation[0] = pose.rotation.x;
+    room_properties.rotation[1] = pose.rotation.y;
+    room_properties.rotation[2] = pose.rotation.z;
+    room_properties.rotation[3] = pose.rotation.w;
+    const Vector3 dimensions = size * transform.basis.get_scale().abs();
+    room_properties.dimensions[0] = dimensions.x;
+    room_properties.dimensions[1] = dimensions.y;
+    room_properties.dimensions[2] = dimensions.z;
+    for (size_t i = 0; i < vraudio::kNumRoomSurfaces; i++) {
+      room_properties.material_names[i] = static_cast<vraudio::MaterialName>(materials[i]);
+    }
+    room_properties.reflection_scalar = reflection_scalar;
+    room_properties.reverb_gain = std::pow(10.0f, reverb_gain_db / 20.0f);
+    room_properties.reverb_brightness = reverb_brightness;
+    room_properties.reverb_time = reverb_time;
+    // Baked RT60s are read straight from the mapped asset.
+    const BakedRoom *baked_room = GetBakedRoom();
+    resonance_world->SetRoom(room, room_properties, baked_room != nullptr ? baked_room->rt60s : nullptr);
+    dirty = false;
+  }
+  // Keep processing while the listener crossfades between rooms.
+  set_process(resonance_world->UpdateRooms());
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -433,17 +1805,231 @@ void GDResonanceRoom::_process(double delta) {
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void GDResonanceSoundfield::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("set_world", "world"), &GDResonanceSoundfield::SetWorld);
+  ClassDB::bind_method(D_METHOD("get_world"), &GDResonanceSoundfield::GetWorld);
+  ClassDB::bind_method(D_METHOD("set_ambisonic_order", "ambisonic_order"), &GDResonanceSoundfield::SetAmbisonicOrder);
+  ClassDB::bind_method(D_METHOD("get_ambisonic_order"), &GDResonanceSoundfield::GetAmbisonicOrder);
+  ClassDB::bind_method(D_METHOD("set_gain", "gain"), &GDResonanceSoundfield::SetGain);
+  ClassDB::bind_method(D_METHOD("get_gain"), &GDResonanceSoundfield::GetGain);
+  ClassDB::bind_method(D_METHOD("set_file", "file"), &GDResonanceSoundfield::SetFile);
+  ClassDB::bind_method(D_METHOD("get_file"), &GDResonanceSoundfield::GetFile);
+  ClassDB::bind_method(D_METHOD("set_loop", "loop"), &GDResonanceSoundfield::SetLoop);
+  ClassDB::bind_method(D_METHOD("is_looping"), &GDResonanceSoundfield::IsLooping);
+  ClassDB::bind_method(D_METHOD("set_autoplay", "autoplay"), &GDResonanceSoundfield::SetAutoplay);
+  ClassDB::bind_method(D_METHOD("is_autoplay_enabled"), &GDResonanceSoundfield::IsAutoplay);
+  ClassDB::bind_method(D_METHOD("play", "from_position"), &GDResonanceSoundfield::Play, DEFVAL(0.0));
+  ClassDB::bind_method(D_METHOD("stop"), &GDResonanceSoundfield::Stop);
+  ClassDB::bind_method(D_METHOD("is_playing"), &GDResonanceSoundfield::IsPlaying);
+  ClassDB::bind_method(D_METHOD("get_playback_position"), &GDResonanceSoundfield::GetPlaybackPosition);
+  ClassDB::bind_method(D_METHOD("push_frames", "frames"), &GDResonanceSoundfield::PushFrames);
+
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::STRING_NAME, "world"), "set_world", "get_world");
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::INT, "ambisonic_order", PROPERTY_HINT_RANGE, "1,3"), "set_ambisonic_order", "get_ambisonic_order");
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::FLOAT, "gain", PROPERTY_HINT_RANGE, "0.0,4.0,0.01"), "set_gain", "get_gain");
+  // Godot imports WAV files as mono or stereo AudioStreamWAV, so ambiX files
+  // are read as they are and need to be imported with "Keep File".
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::STRING, "file", PROPERTY_HINT_FILE, "*.wav,*.amb"), "set_file", "get_file");
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::BOOL, "loop"), "set_loop", "is_looping");
+  ClassDB::add_property("GDResonanceSoundfield", PropertyInfo(Variant::BOOL, "autoplay"), "set_autoplay", "is_autoplay_enabled");
 }
 
 GDResonanceSoundfield::GDResonanceSoundfield() {
     // Initialize any variables here.
-    resonance_audio = 0.0;
+    resonance_world = nullptr;
+    source = ResonanceWorld::kInvalidSourceHandle;
+    ambisonic_order = 1;
+    gain = 1.0f;
+    loop = false;
+    autoplay = false;
+    voice = ResonanceStreamer::kInvalidVoiceHandle;
 }
 
 GDResonanceSoundfield::~GDResonanceSoundfield() {
     // Add your cleanup here.
 }
 
-void GDResonanceSoundfield::_process(double delta) {
+void GDResonanceSoundfield::SetWorld(const StringName &p_world){
+  if (is_inside_tree()) {
+    Unregister();
+  }
+  world = p_world;
+  if (is_inside_tree()) {
+    Register();
+  }
+}
+
+StringName GDResonanceSoundfield::GetWorld() const {
+  return world;
+}
 
-}
\ No newline at end of file
+void GDResonanceSoundfield::SetAmbisonicOrder(int p_ambisonic_order){
+  if (!is_inside_tree()) {
+    ambisonic_order = CLAMP(p_ambisonic_order, 1, 3);
+    return;
+  }
+  // The soundfield is registered again with the new channel count; a playing
+  // file carries on from where it was.
+  const bool playing = IsPlaying();
+  const double position = GetPlaybackPosition();
+  Unregister();
+  ambisonic_order = CLAMP(p_ambisonic_order, 1, 3);
+  Register();
+  if (playing) {
+    Play(position);
+  }
+}
+
+int GDResonanceSoundfield::GetAmbisonicOrder() const {
+  return ambisonic_order;
+}
+
+void GDResonanceSoundfield::SetGain(float p_gain){
+  gain = p_gain;
+  if (is_inside_tree()) {
+    resonance_world->SetSourceGain(source, gain);
+  }
+}
+
+float GDResonanceSoundfield::GetGain() const {
+  return gain;
+}
+
+void GDResonanceSoundfield::SetFile(const String &p_file){
+  if (is_inside_tree()) {
+    Unregister();
+  }
+  file = p_file;
+  clip.reset();
+  if (!file.is_empty()) {
+    const PackedByteArray data = FileAccess::get_file_as_bytes(file);
+    auto decoded = std::make_shared<StreamClip>();
+    if (!ReadWav(data.ptr(), data.size(), decoded.get()) || decoded->num_channels < 4) {
+      ERR_PRINT("GDResonanceSoundfield plays ambiX WAV files of at least 4 channels: " + file);
+    } else {
+      decoded->loop = loop;
+      clip = decoded;
+    }
+  }
+  if (is_inside_tree()) {
+    Register();
+  }
+}
+
+String GDResonanceSoundfield::GetFile() const {
+  return file;
+}
+
+void GDResonanceSoundfield::SetLoop(bool p_loop){
+  loop = p_loop;
+  if (clip != nullptr && clip->loop != loop) {
+    // Clips are immutable once playing; the new one applies from the next
+    // play().
+    auto copy = std::make_shared<StreamClip>(*clip);
+    copy->loop = loop;
+    clip = copy;
+  }
+}
+
+bool GDResonanceSoundfield::IsLooping() const {
+  return loop;
+}
+
+void GDResonanceSoundfield::SetAutoplay(bool p_autoplay){
+  autoplay = p_autoplay;
+}
+
+bool GDResonanceSoundfield::IsAutoplay() const {
+  return autoplay;
+}
+
+void GDResonanceSoundfield::Play(double p_from_position){
+  ERR_FAIL_COND_MSG(!is_inside_tree(), "GDResonanceSoundfield must be inside the tree to play.");
+  Stop();
+  voice = resonance_world->streamer()->Play(clip, source, ResonanceWorld::kInvalidSourceHandle,
+                                            p_from_position);
+}
+
+void GDResonanceSoundfield::Stop(){
+  if (voice != ResonanceStreamer::kInvalidVoiceHandle) {
+    resonance_world->streamer()->Stop(voice);
+    voice = ResonanceStreamer::kInvalidVoiceHandle;
+  }
+}
+
+bool GDResonanceSoundfield::IsPlaying() const {
+  return voice != ResonanceStreamer::kInvalidVoiceHandle &&
+         resonance_world->streamer()->IsPlaying(voice);
+}
+
+double GDResonanceSoundfield::GetPlaybackPosition() const {
+  if (voice == ResonanceStreamer::kInvalidVoiceHandle) {
+    return 0.0;
+  }
+  return resonance_world->streamer()->GetPosition(voice);
+}
+
+int GDResonanceSoundfield::PushFrames(const PackedFloat32Array &p_frames){
+  if (resonance_world == nullptr) {
+    return 0;
+  }
+  ERR_FAIL_COND_V_MSG(voice != ResonanceStreamer::kInvalidVoiceHandle, 0,
+                      "GDResonanceSoundfield cannot take pushed frames while it plays its file.");
+  const int order = GetRenderedOrder();
+  const int num_channels = (order + 1) * (order + 1);
+  return resonance_world->PushInput(source, p_frames.ptr(), p_frames.size() / num_channels);
+}
+
+int GDResonanceSoundfield::GetRenderedOrder() const {
+  if (clip == nullptr) {
+    return ambisonic_order;
+  }
+  // A file of lower order is not padded with silent channels.
+  int clip_order = 1;
+  while (clip_order < 3 && (clip_order + 2) * (clip_order + 2) <= static_cast<int>(clip->num_channels)) {
+    clip_order++;
+  }
+  return MIN(ambisonic_order, clip_order);
+}
+
+void GDResonanceSoundfield::Register() {
+  resonance_world = get_resonance_world(world);
+  const int order = GetRenderedOrder();
+  source = resonance_world->AddSoundfield((order + 1) * (order + 1));
+  resonance_world->SetSourceGain(source, gain);
+  if (autoplay && clip != nullptr && !Engine::get_singleton()->is_editor_hint()) {
+    Play(0.0);
+  }
+  pose.valid = false;
+  set_notify_transform(true);
+  set_process(true);
+}
+
+void GDResonanceSoundfield::Unregister() {
+  Stop();
+  resonance_world->RemoveSource(source);
+  source = ResonanceWorld::kInvalidSourceHandle;
+}
+
+void GDResonanceSoundfield::_enter_tree() {
+  Register();
+}
+
+void GDResonanceSoundfield::_exit_tree() {
+  Unregister();
+}
+
+void GDResonanceSoundfield::_notification(int p_what) {
+  if (p_what == NOTIFICATION_TRANSFORM_CHANGED) {
+    set_process(true);
+  }
+}
+
+void GDResonanceSoundfield::_process(double delta) {
+  // Only the rotation of a soundfield is audible.
+  if (pose.Update(get_global_transform())) {
+    resonance_world->SetSourceTransform(source, pose.position.x, pose.position.y,
+                                        pose.position.z, pose.rotation.x, pose.rotation.y,
+                                        pose.rotation.z, pose.rotation.w);
+  }
+  set_process(false);
+}
@@ -1,24 +1,65 @@
 #ifndef GDResonance_H
 #define GDResonance_H
 
+#include <godot_cpp/classes/audio_stream.hpp>
 #include <godot_cpp/classes/audio_stream_player.hpp>
 //#include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/classes/audio_effect_instance.hpp>
 #include <godot_cpp/classes/audio_effect.hpp>
+#include <godot_cpp/classes/curve.hpp>
 #include <godot_cpp/classes/node3d.hpp>
+#include <godot_cpp/classes/physics_direct_space_state3d.hpp>
+#include <godot_cpp/classes/physics_ray_query_parameters3d.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
 
 #include "api/resonance_audio_api.h"
 #include "platforms/common/room_properties.h"
 
+#include "acoustic_bake.h"
+#include "resonance_streamer.h"
+#include "resonance_world.h"
+
 class GDResonanceEffect;
 
+// Position and rotation last pushed to a ResonanceWorld. Update() stores the
+// pose of |transform| and returns true only when it moved past the thresholds,
+// so static nodes cost no parameter updates.
+struct ResonancePose {
+    godot::Vector3 position;
+    godot::Quaternion rotation;
+    bool valid = false;
+
+    bool Update(const godot::Transform3D &transform);
+};
+
 class GDResonance : public godot::AudioEffectInstance {
     GDCLASS(GDResonance, godot::AudioEffectInstance)
 
     friend class GDResonanceEffect;
 	godot::Ref<GDResonanceEffect> base;
 
-//private:
+private:
+    // World rendered by this instance, set by GDResonanceEffect::_instantiate.
+    ResonanceWorld *world;
+
+    // Source fed with the audio of the bus this effect sits on, and the
+    // position it was last moved to.
+    ResonanceWorld::SourceHandle bus_source;
+    godot::Vector3 bus_position;
+    bool bus_position_valid;
+
+    // Sample rate the graph of |world| was built for. A different AudioServer
+    // mix rate schedules a rebuild on the main thread.
+    std::atomic<int> graph_rate;
+    std::atomic<bool> rebuild_pending;
+
+    // Scratch buffers for one chunk of the bus block, sized up front so the
+    // audio thread never allocates.
+    std::vector<float> input_buffer;
+    std::vector<float> output_buffer;
+
+    void Attach(ResonanceWorld *p_world);
+    void RebuildGraph();
 
 protected:
     static void _bind_methods();
@@ -36,61 +77,63 @@ public:
     // Shuts down the ResonanceAudio system.
     void Shutdown();
 
-    // Processes the next output buffer and stores the processed buffer in |output|.
+    // Renders the next output buffer of all sources and stores it in |output|.
     // This method must be called from the audio thread.
     void ProcessListener(size_t num_frames, float* output);
 
-    // Updates the listener's position and rotation.
+    // Updates the listener's position and rotation. This and the other Set*
+    // methods queue the update for the audio thread and must be called from
+    // the game thread.
     void SetListenerTransform(float px, float py, float pz, float qx, float qy,
                             float qz, float qw);
 
     // Creates an ambiX format soundfield and connects it to the audio manager.
-    vraudio::ResonanceAudioApi::SourceId CreateSoundfield(int num_channels);
+    ResonanceWorld::SourceHandle CreateSoundfield(int num_channels);
 
     // Creates a sound object sub-graph and connects it to the audio manager.
-    vraudio::ResonanceAudioApi::SourceId CreateSoundObject(vraudio::RenderingMode rendering_mode);
+    ResonanceWorld::SourceHandle CreateSoundObject(vraudio::RenderingMode rendering_mode);
 
     // Disconnects the source with |id| from the pipeline and releases its
     // resources.
-    void DestroySource(vraudio::ResonanceAudioApi::SourceId id);
+    void DestroySource(ResonanceWorld::SourceHandle id);
 
-    // Passes the next input buffer of the source to the system. This method must be
-    // called from the audio thread.
-    void ProcessSource(vraudio::ResonanceAudioApi::SourceId id, size_t num_channels,
+    // Queues the next input buffer of the source. It is rendered with the next
+    // ProcessListener() call.
+    void ProcessSource(ResonanceWorld::SourceHandle id, size_t num_channels,
                     size_t num_frames, float* input);
 
     // Updates the directivity parameters of the source.
-    void SetSourceDirectivity(vraudio::ResonanceAudioApi::SourceId id, float alpha,
+    void SetSourceDirectivity(ResonanceWorld::SourceHandle id, float alpha,
                             float order);
 
     // Sets the computed distance attenuation of a source.
-    void SetSourceDistanceAttenuation(vraudio::ResonanceAudioApi::SourceId id,
+    void SetSourceDistanceAttenuation(ResonanceWorld::SourceHandle id,
                                     float distance_attenuation);
 
     // Updates the gain of the source.
-    void SetSourceGain(vraudio::ResonanceAudioApi::SourceId id, float gain);
+    void SetSourceGain(ResonanceWorld::SourceHandle id, float gain);
 
     // Updates the listener directivity parameters of the source.
-    void SetSourceListenerDirectivity(vraudio::ResonanceAudioApi::SourceId id, float alpha,
+    void SetSourceListenerDirectivity(ResonanceWorld::SourceHandle id, float alpha,
                                     float order);
 
     // Updates the near field effect gain for the source.
-    void SetSourceNearFieldEffectGain(vraudio::ResonanceAudioApi::SourceId id,
+    void SetSourceNearFieldEffectGain(ResonanceWorld::SourceHandle id,
                                     float near_field_effect_gain);
 
     // Updates the occlusion intensity of the source.
-    void SetSourceOcclusionIntensity(vraudio::ResonanceAudioApi::SourceId id,
+    void SetSourceOcclusionIntensity(ResonanceWorld::SourceHandle id,
                                     float intensity);
 
     // Sets the room effects gain for the source.
-    void SetSourceRoomEffectsGain(vraudio::ResonanceAudioApi::SourceId id,
+    void SetSourceRoomEffectsGain(ResonanceWorld::SourceHandle id,
                                 float room_effects_gain);
 
     // Updates the spread of the source.
-    void SetSourceSpread(vraudio::ResonanceAudioApi::SourceId id, float spread_deg);
+    void SetSourceSpread(ResonanceWorld::SourceHandle id, float spread_deg);
 
     // Updates the position, rotation and scale of the source.
-    void SetSourceTransform(vraudio::ResonanceAudioApi::SourceId id, float px, float py,
+    void SetSourceTransform(ResonanceWorld::SourceHandle id, float px, float py,
                             float pz, float qx, float qy, float qz, float qw);
 
     // Updates the listener's master gain.
@@ -116,6 +159,34 @@ class GDResonanceEffect : public godot::AudioEffect {
     float py;
     float pz;
 
+    // Name of the ResonanceWorld rendered by the instances of this effect.
+    godot::StringName world;
+
+    // Number of sound objects the world renders per block.
+    int max_voices;
+
+    // Distances below which automatic sources render at high, medium and low
+    // binaural quality; beyond the last one they fall back to stereo panning.
+    float lod_distances[3];
+    // Rendering cost the world may spend per block, in high quality sources.
+    float lod_budget;
+    // Sound objects the world creates up front, per vraudio::RenderingMode.
+    int source_pool_sizes[kNumPooledRenderingModes];
+    // Ambisonic sources per order the world creates up front for soundfields.
+    int soundfield_pool_size;
+    // ResonanceAudio instances the world renders in parallel.
+    int render_groups;
+    // Gain over the distance range of the sources with
+    // GDResonanceSource::ATTENUATION_CUSTOM, sampled from 0 (min_distance) to
+    // 1 (max_distance). Without a curve they fall off linearly.
+    godot::Ref<godot::Curve> distance_curve;
+
+    // World whose Performance monitors this effect registered, see AddMonitors.
+    godot::String monitor_world;
+
+    void AddMonitors();
+    void RemoveMonitors();
+
     protected:
         static void _bind_methods();
 
@@ -131,6 +202,103 @@ class GDResonanceEffect : public godot::AudioEffect {
         float GetY() const;
         float GetZ() const;
 
+        void SetWorld(const godot::StringName &p_world);
+        godot::StringName GetWorld() const;
+
+        void SetMaxVoices(int p_max_voices);
+        int GetMaxVoices() const;
+
+        void SetLodHighDistance(float p_distance);
+        void SetLodMediumDistance(float p_distance);
+        void SetLodLowDistance(float p_distance);
+
+        float GetLodHighDistance() const;
+        float GetLodMediumDistance() const;
+        float GetLodLowDistance() const;
+
+        void SetLodBudget(float p_budget);
+        float GetLodBudget() const;
+
+        void SetSourcePoolSize(int p_rendering_mode, int p_size);
+        int GetSourcePoolSize(int p_rendering_mode) const;
+        void SetSoundfieldPoolSize(int p_size);
+        int GetSoundfieldPoolSize() const;
+
+        void SetRenderGroups(int p_render_groups);
+        int GetRenderGroups() const;
+
+        void SetDistanceCurve(const godot::Ref<godot::Curve> &p_curve);
+        godot::Ref<godot::Curve> GetDistanceCurve() const;
+        // Hands |distance_curve| to the world, also whenever the curve changes.
+        void UpdateDistanceCurve();
+
+        // Bulk updates of the sources |p_ids| (GDResonanceSource::get_source_id)
+        // in one call: three position and four rotation floats per source, or
+        // no rotations for the identity, and one gain per source. The id of a
+        // stereo source covers both of its channels. They bypass the nodes, so
+        // a node that moves or has its gain set afterwards overrides them.
+        void SetSourceTransforms(const godot::PackedInt32Array &p_ids,
+                                 const godot::PackedFloat32Array &p_positions,
+                                 const godot::PackedFloat32Array &p_rotations);
+        void SetSourceGains(const godot::PackedInt32Array &p_ids,
+                            const godot::PackedFloat32Array &p_gains);
+
+        // Rendering cost of the world over its recent blocks, see
+        // ResonanceStats. Times are in milliseconds.
+        godot::Dictionary GetStats() const;
+        // Value of a custom Performance monitor, one entry of GetStats().
+        godot::Variant GetMonitor(const godot::String &p_key) const;
+
+        godot::Ref<godot::AudioEffectInstance> _instantiate();
+};
+
+// Send: hands the audio of its bus to a GDResonanceSource of the shared renderer.
+
+class GDResonanceSendEffect;
+
+class GDResonanceSend : public godot::AudioEffectInstance {
+    GDCLASS(GDResonanceSend, godot::AudioEffectInstance)
+
+    friend class GDResonanceSendEffect;
+	godot::Ref<GDResonanceSendEffect> base;
+
+    std::vector<float> input_buffer;
+
+protected:
+    static void _bind_methods();
+
+public:
+    GDResonanceSend();
+    ~GDResonanceSend();
+
+    void _process(godot::AudioFrame *src_buffer, godot::AudioFrame *dst_buffer, int32_t frame_count);
+};
+
+class GDResonanceSendEffect : public godot::AudioEffect {
+    GDCLASS(GDResonanceSendEffect, godot::AudioEffect)
+
+    friend class GDResonanceSend;
+
+    // Set by the GDResonanceSource bound to this bus, read on the audio thread.
+    // A stereo source feeds its right channel to |source_right|, a mono one
+    // leaves it invalid and gets the downmix of both channels.
+    std::atomic<ResonanceWorld *> world;
+    std::atomic<ResonanceWorld::SourceHandle> source;
+    std::atomic<ResonanceWorld::SourceHandle> source_right;
+
+    protected:
+        static void _bind_methods();
+
+    public:
+        GDResonanceSendEffect();
+        ~GDResonanceSendEffect();
+
+        void SetSource(ResonanceWorld *p_world, ResonanceWorld::SourceHandle handle,
+                       ResonanceWorld::SourceHandle right_handle = ResonanceWorld::kInvalidSourceHandle);
+        ResonanceWorld::SourceHandle GetSource() const;
+        ResonanceWorld::SourceHandle GetSourceRight() const;
+        ResonanceWorld *GetResonanceWorld() const;
+
         godot::Ref<godot::AudioEffectInstance> _instantiate();
 };
 
@@ -140,66 +308,378 @@ class GDResonanceListener : public godot::Node3D {
     GDCLASS(GDResonanceListener, godot::Node3D)
 
 private:
-    double resonance_audio;
+    ResonanceWorld *resonance_world;
+
+    // Name of the ResonanceWorld this node is the listener of.
+    godot::StringName world;
+
+    ResonancePose pose;
+
+    // Occlusion: every physics frame up to |occlusion_rays_per_frame| rays are
+    // cast from the listener towards the sound objects of the world, resuming
+    // where the previous frame stopped. Each occluder found on the way adds
+    // |occlusion_intensity|; the result is smoothed over |occlusion_smoothing|
+    // seconds and changed values are handed to the world in one batch.
+    struct OcclusionState {
+      float target;
+      float current;
+      float pushed;
+      // Value of |occlusion_frame| when the source was last seen.
+      uint32_t seen;
+    };
+
+    // Rays spent on one source at most, bounding the occluders it can count.
+    static const int kMaxOccluders = 3;
+
+    bool occlusion;
+    int occlusion_rays_per_frame;
+    uint32_t occlusion_collision_mask;
+    float occlusion_intensity;
+    float occlusion_smoothing;
+    godot::Ref<godot::PhysicsRayQueryParameters3D> occlusion_query;
+    godot::TypedArray<godot::RID> occlusion_exclude;
+    ResonanceWorld::SourceHandle occlusion_cursor;
+    uint32_t occlusion_frame;
+    std::vector<OcclusionState> occlusion_states;
+    // Batch handed to SetSourceOcclusionIntensities(), preallocated.
+    std::vector<ResonanceWorld::SourceHandle> occlusion_handles;
+    std::vector<float> occlusion_values;
+
+    void UpdateOcclusion(double delta);
+    // Counts the occluders between |from| and |to| with at most |max_rays|
+    // rays, and adds the rays cast to |num_rays|.
+    int CountOccluders(godot::PhysicsDirectSpaceState3D *space, const godot::Vector3 &from,
+                       const godot::Vector3 &to, int max_rays, int *num_rays);
+    // Clears the occlusion this listener set on the sources of its world.
+    void ResetOcclusion();
 
 protected:
     static void _bind_methods();
+    void _notification(int p_what);
 
 public:
     GDResonanceListener();
     ~GDResonanceListener();
 
+    void SetWorld(const godot::StringName &p_world);
+    godot::StringName GetWorld() const;
+
+    void SetOcclusion(bool p_occlusion);
+    bool GetOcclusion() const;
+
+    void SetOcclusionRaysPerFrame(int p_rays);
+    int GetOcclusionRaysPerFrame() const;
+
+    void SetOcclusionCollisionMask(uint32_t p_mask);
+    uint32_t GetOcclusionCollisionMask() const;
+
+    void SetOcclusionIntensity(float p_intensity);
+    float GetOcclusionIntensity() const;
+
+    void SetOcclusionSmoothing(float p_smoothing);
+    float GetOcclusionSmoothing() const;
+
+    void _enter_tree();
+    void _exit_tree();
     void _process(double delta);
+    void _physics_process(double delta);
 };
 
 class GDResonanceSource : public godot::Node3D {
     GDCLASS(GDResonanceSource, godot::Node3D)
 
 private:
-    double resonance_audio;
+    ResonanceWorld *resonance_world;
+    ResonanceWorld::SourceHandle source;
+    // Right channel of a stereo source, invalid in mono.
+    ResonanceWorld::SourceHandle source_right;
+
+    // Bus whose GDResonanceSendEffect feeds this source.
+    godot::StringName bus;
+
+    // Name of the ResonanceWorld this source is rendered by.
+    godot::StringName world;
+
+    float gain;
+    // Weighs the audibility of this source when voices are scarce.
+    float priority;
+    // vraudio::RenderingMode, or ResonanceWorld::kRenderingModeAuto to pick it
+    // by distance.
+    int rendering_mode;
+    // CHANNEL_MODE_MONO renders the downmix of the bus at the node. In
+    // CHANNEL_MODE_STEREO each channel is its own source, placed
+    // |stereo_width| apart along the local x axis.
+    int channel_mode;
+    float stereo_width;
+    // DistanceModel the world attenuates this source with between
+    // |min_distance| and |max_distance|, and the near-field effect gain
+    // applied within a meter of the listener.
+    int attenuation_model;
+    float min_distance;
+    float max_distance;
+    float near_field_gain;
+
+    // Played straight into the source instead of the bus. |clip| holds its
+    // decoded frames and |voice| the playback in the world's streamer.
+    godot::Ref<godot::AudioStream> stream;
+    bool autoplay;
+    std::shared_ptr<const StreamClip> clip;
+    ResonanceStreamer::VoiceHandle voice;
+
+    ResonancePose pose;
+
+    void Register();
+    void Unregister();
+    void BindSends(ResonanceWorld::SourceHandle handle, ResonanceWorld::SourceHandle right_handle);
+    void PushTransform();
+    void PushDistanceModel(ResonanceWorld::SourceHandle handle);
 
 protected:
     static void _bind_methods();
+    void _notification(int p_what);
 
 public:
+    enum ChannelMode { CHANNEL_MODE_MONO, CHANNEL_MODE_STEREO };
+    enum AttenuationModel {
+        ATTENUATION_DISABLED = kDistanceModelNone,
+        ATTENUATION_LOGARITHMIC = kDistanceModelLogarithmic,
+        ATTENUATION_LINEAR = kDistanceModelLinear,
+        ATTENUATION_CUSTOM = kDistanceModelCustom,
+    };
+
     GDResonanceSource();
     ~GDResonanceSource();
 
+    void SetBus(const godot::StringName &p_bus);
+    godot::StringName GetBus() const;
+
+    void SetWorld(const godot::StringName &p_world);
+    godot::StringName GetWorld() const;
+
+    void SetGain(float p_gain);
+    float GetGain() const;
+
+    void SetPriority(float p_priority);
+    float GetPriority() const;
+
+    void SetRenderingMode(int p_rendering_mode);
+    int GetRenderingMode() const;
+
+    void SetChannelMode(int p_channel_mode);
+    int GetChannelMode() const;
+
+    void SetStereoWidth(float p_stereo_width);
+    float GetStereoWidth() const;
+
+    void SetAttenuationModel(int p_attenuation_model);
+    int GetAttenuationModel() const;
+
+    void SetMinDistance(float p_min_distance);
+    float GetMinDistance() const;
+
+    void SetMaxDistance(float p_max_distance);
+    float GetMaxDistance() const;
+
+    void SetNearFieldGain(float p_near_field_gain);
+    float GetNearFieldGain() const;
+
+    void SetStream(const godot::Ref<godot::AudioStream> &p_stream);
+    godot::Ref<godot::AudioStream> GetStream() const;
+
+    void SetAutoplay(bool p_autoplay);
+    bool IsAutoplay() const;
+
+    void Play(double p_from_position);
+    void Stop();
+    bool IsPlaying() const;
+    double GetPlaybackPosition() const;
+
+    ResonanceWorld::SourceHandle GetSourceId() const;
+
+    void _enter_tree();
+    void _exit_tree();
     void _process(double delta);
 };
 
 
+// Room: a shoebox of size |size| centered on the node, scaled and rotated
+// with it, whose walls drive the early reflections and reverb of its world
+// while the listener is inside. Nested rooms take precedence over the rooms
+// around them.
+
+struct SharedBakedAcoustics;
+
 class GDResonanceRoom : public godot::Node3D {
     GDCLASS(GDResonanceRoom, godot::Node3D)
 
 private:
-    double resonance_audio;
+    ResonanceWorld *resonance_world;
+
+    // Name of the ResonanceWorld this room applies to.
+    godot::StringName world;
+
+    godot::Vector3 size;
+    // vraudio::MaterialName per surface, in vraudio::RoomProperties order.
+    int materials[vraudio::kNumRoomSurfaces];
+    float reflection_scalar;
+    float reverb_gain_db;
+    float reverb_brightness;
+    float reverb_time;
+
+    // Volume of this room in |resonance_world| while inside the tree.
+    ResonanceWorld::RoomHandle room;
+
+    // Asset Bake() stores the RT60s of this room in. While inside the tree
+    // |baked| holds it, shared with the other rooms of the same file, and
+    // |baked_key| is the key of the record of this room.
+    godot::String baked_acoustics;
+    SharedBakedAcoustics *baked;
+    uint64_t baked_key;
+
+    ResonancePose pose;
+    // Set when a property changed, so the next _process pushes the room.
+    bool dirty;
+
+    void MarkDirty();
+    void LoadBakedAcoustics();
+    void ReleaseBakedAcoustics();
+    // Record of this room in |baked|, or null to compute the reverb from the
+    // shoebox. Valid until the asset is baked again.
+    const BakedRoom *GetBakedRoom() const;
+    // Path of this room within its scene, which its bake is stored under.
+    godot::String GetBakeName() const;
 
 protected:
     static void _bind_methods();
+    void _notification(int p_what);
 
 public:
+    enum Surface {
+        SURFACE_LEFT_WALL,
+        SURFACE_RIGHT_WALL,
+        SURFACE_FLOOR,
+        SURFACE_CEILING,
+        SURFACE_FRONT_WALL,
+        SURFACE_BACK_WALL,
+    };
+
     GDResonanceRoom();
     ~GDResonanceRoom();
 
+    void SetWorld(const godot::StringName &p_world);
+    godot::StringName GetWorld() const;
+
+    void SetSize(const godot::Vector3 &p_size);
+    godot::Vector3 GetSize() const;
+
+    void SetMaterial(int p_surface, int p_material);
+    int GetMaterial(int p_surface) const;
+
+    void SetReflectionScalar(float p_reflection_scalar);
+    float GetReflectionScalar() const;
+
+    void SetReverbGainDb(float p_reverb_gain_db);
+    float GetReverbGainDb() const;
+
+    void SetReverbBrightness(float p_reverb_brightness);
+    float GetReverbBrightness() const;
+
+    void SetReverbTime(float p_reverb_time);
+    float GetReverbTime() const;
+
+    void SetBakedAcoustics(const godot::String &p_baked_acoustics);
+    godot::String GetBakedAcoustics() const;
+
+    // Editor time: traces |p_rays| physics rays from the room center through
+    // the colliders of |p_collision_mask| and stores the RT60s of the room in
+    // baked_acoustics. Colliders with a "resonance_material" meta absorb like
+    // that vraudio::MaterialName, other surfaces like the room surface they
+    // face. The reverb of the room follows the bake from then on, without
+    // any ray tracing at runtime; reflections stay those of the shoebox.
+    bool Bake(int p_rays, int64_t p_collision_mask);
+    bool IsBaked() const;
+
+    void _enter_tree();
+    void _exit_tree();
     void _process(double delta);
 };
 
 
+// Soundfield: an ambiX (ACN/SN3D) recording rotated with the node.
+
 class GDResonanceSoundfield : public godot::Node3D {
     GDCLASS(GDResonanceSoundfield, godot::Node3D)
 
 private:
-    double resonance_audio;
+    ResonanceWorld *resonance_world;
+    ResonanceWorld::SourceHandle source;
+
+    // Name of the ResonanceWorld this soundfield is rendered by.
+    godot::StringName world;
+
+    // Highest ambisonic order rendered, (order + 1)^2 channels. A file of
+    // higher order is truncated to it, trading spatial detail for CPU.
+    int ambisonic_order;
+    float gain;
+
+    // ambiX WAV file played into the soundfield. |clip| holds its decoded
+    // frames and |voice| the playback in the world's streamer.
+    godot::String file;
+    bool loop;
+    bool autoplay;
+    std::shared_ptr<const StreamClip> clip;
+    ResonanceStreamer::VoiceHandle voice;
+
+    ResonancePose pose;
+
+    // Order the soundfield is registered with.
+    int GetRenderedOrder() const;
+
+    void Register();
+    void Unregister();
 
 protected:
     static void _bind_methods();
+    void _notification(int p_what);
 
 public:
     GDResonanceSoundfield();
     ~GDResonanceSoundfield();
 
+    void SetWorld(const godot::StringName &p_world);
+    godot::StringName GetWorld() const;
+
+    void SetAmbisonicOrder(int p_ambisonic_order);
+    int GetAmbisonicOrder() const;
+
+    void SetGain(float p_gain);
+    float GetGain() const;
+
+    void SetFile(const godot::String &p_file);
+    godot::String GetFile() const;
+
+    void SetLoop(bool p_loop);
+    bool IsLooping() const;
+
+    void SetAutoplay(bool p_autoplay);
+    bool IsAutoplay() const;
+
+    void Play(double p_from_position);
+    void Stop();
+    bool IsPlaying() const;
+    double GetPlaybackPosition() const;
+
+    // Queues interleaved ambiX frames and returns how many frames fit. Not
+    // available while the file plays.
+    int PushFrames(const godot::PackedFloat32Array &p_frames);
+
+    void _enter_tree();
+    void _exit_tree();
     void _process(double delta);
 };
 
+VARIANT_ENUM_CAST(GDResonanceSource::ChannelMode);
+VARIANT_ENUM_CAST(GDResonanceSource::AttenuationModel);
+VARIANT_ENUM_CAST(GDResonanceRoom::Surface);
+
 #endif
\ No newline at end of file
@@ -16,6 +16,8 @@ void initialize_resonance_module(ModuleInitializationLevel p_level) {
 
     ClassDB::register_class<GDResonance>();
     ClassDB::register_class<GDResonanceEffect>();
+    ClassDB::register_class<GDResonanceSend>();
+    ClassDB::register_class<GDResonanceSendEffect>();
     ClassDB::register_class<GDResonanceListener>();
     ClassDB::register_class<GDResonanceSource>();
     ClassDB::register_class<GDResonanceRoom>();
@@ -26,6 +28,8 @@ void uninitialize_resonance_module(ModuleInitializationLevel p_level) {
     if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
         return;
     }
+
+    ResonanceWorld::ReleaseAll();
 }
 
 extern "C" {
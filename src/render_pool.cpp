@@ -0,0 +1,78 @@
+#include "render_pool.h"
+
+#include <chrono>
+
+RenderPool::RenderPool(int num_threads)
+    : stop_(false),
+      job_(nullptr),
+      context_(nullptr),
+      count_(0),
+      next_(0),
+      done_(0),
+      generation_(0) {
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&RenderPool::Loop, this);
+  }
+}
+
+RenderPool::~RenderPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void RenderPool::Run(Job job, void* context, int count) {
+  ++generation_;
+  job_.store(job, std::memory_order_relaxed);
+  context_.store(context, std::memory_order_relaxed);
+  count_.store(count, std::memory_order_relaxed);
+  done_.store(0, std::memory_order_relaxed);
+  next_.store(static_cast<uint64_t>(generation_) << 32, std::memory_order_release);
+  // Notifying without the lock keeps the caller from blocking on a worker.
+  wake_.notify_all();
+
+  while (RunNext(generation_)) {
+  }
+  while (done_.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+}
+
+bool RenderPool::RunNext(uint32_t generation) {
+  uint64_t next = next_.load(std::memory_order_acquire);
+  while (static_cast<uint32_t>(next >> 32) == generation) {
+    const int index = static_cast<int>(next & 0xffffffffu);
+    if (index >= count_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    if (next_.compare_exchange_weak(next, next + 1, std::memory_order_acq_rel)) {
+      job_.load(std::memory_order_relaxed)(context_.load(std::memory_order_relaxed), index);
+      done_.fetch_add(1, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RenderPool::Loop() {
+  uint32_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const uint32_t generation =
+        static_cast<uint32_t>(next_.load(std::memory_order_acquire) >> 32);
+    if (generation != seen) {
+      seen = generation;
+      lock.unlock();
+      while (RunNext(generation)) {
+      }
+      lock.lock();
+      continue;
+    }
+    wake_.wait_for(lock, std::chrono::milliseconds(kWakeTimeoutMs));
+  }
+}
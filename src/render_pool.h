@@ -0,0 +1,58 @@
+#ifndef GDRESONANCE_RENDER_POOL_H
+#define GDRESONANCE_RENDER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the jobs of one audio block on worker threads, with the calling thread
+// taking part. Jobs are claimed one at a time from a shared counter, so threads
+// that finish early take over the remaining jobs and unbalanced jobs do not
+// leave cores idle.
+//
+// The calling thread only ever waits for jobs a worker has started: jobs nobody
+// claimed run on the calling thread, so a worker that is slow to wake up costs
+// parallelism, never a deadline.
+class RenderPool {
+public:
+    typedef void (*Job)(void* context, int index);
+
+    explicit RenderPool(int num_threads);
+    ~RenderPool();
+
+    // Runs |job| with |context| for every index in [0, count) and returns once
+    // all of them ran. Neither locks nor allocates; one caller at a time.
+    void Run(Job job, void* context, int count);
+
+private:
+    // How long an idle worker sleeps before it looks for jobs regardless,
+    // covering a wakeup it missed.
+    static const int kWakeTimeoutMs = 1;
+
+    void Loop();
+    // Claims and runs the next job of |generation|. Returns false once none
+    // is left.
+    bool RunNext(uint32_t generation);
+
+    std::vector<std::thread> threads_;
+    // Guards |stop_|; workers sleep on |wake_| between blocks.
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_;
+
+    std::atomic<Job> job_;
+    std::atomic<void*> context_;
+    std::atomic<int> count_;
+    // Generation of the current Run() in the upper 32 bits, next job index in
+    // the lower ones, so that a worker late from the previous block cannot
+    // claim a job of the current one.
+    std::atomic<uint64_t> next_;
+    std::atomic<int> done_;
+    // Caller state.
+    uint32_t generation_;
+};
+
+#endif // GDRESONANCE_RENDER_POOL_H
@@ -0,0 +1,188 @@
+#include "resonance_streamer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// How often the worker tops up the rings; well below the prefetched duration.
+const auto kPrefetchInterval = std::chrono::milliseconds(5);
+
+}  // namespace
+
+ResonanceStreamer::ResonanceStreamer(ResonanceWorld* world)
+    : world_(world),
+      stop_(false),
+      voices_(ResonanceWorld::kMaxSources),
+      left_(kChunkFrames * kMaxChannels),
+      right_(kChunkFrames) {
+  for (Voice& voice : voices_) {
+    voice.used = false;
+    voice.playing = false;
+  }
+}
+
+ResonanceStreamer::~ResonanceStreamer() {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+  }
+}
+
+ResonanceStreamer::VoiceHandle ResonanceStreamer::Play(std::shared_ptr<const StreamClip> clip,
+                                                       ResonanceWorld::SourceHandle left,
+                                                       ResonanceWorld::SourceHandle right,
+                                                       double position) {
+  if (clip == nullptr || clip->num_frames == 0 || clip->sample_rate <= 0 ||
+      left == ResonanceWorld::kInvalidSourceHandle) {
+    return kInvalidVoiceHandle;
+  }
+  const size_t num_channels = world_->GetInputChannels(left);
+  if (num_channels == 0 || num_channels > kMaxChannels) {
+    return kInvalidVoiceHandle;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < static_cast<int>(voices_.size()); ++i) {
+    Voice& voice = voices_[i];
+    if (voice.used) {
+      continue;
+    }
+    voice.used = true;
+    voice.playing = true;
+    voice.left = left;
+    voice.right = right;
+    voice.num_channels = num_channels;
+    voice.position = std::min(std::max(position, 0.0) * clip->sample_rate,
+                              static_cast<double>(clip->num_frames));
+    voice.clip = std::move(clip);
+    if (!worker_.joinable()) {
+      worker_ = std::thread(&ResonanceStreamer::Loop, this);
+    }
+    wake_.notify_one();
+    return i;
+  }
+  return kInvalidVoiceHandle;
+}
+
+void ResonanceStreamer::Stop(VoiceHandle handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle < 0 || handle >= static_cast<int>(voices_.size())) {
+    return;
+  }
+  Voice& voice = voices_[handle];
+  voice.used = false;
+  voice.playing = false;
+  voice.clip.reset();
+}
+
+bool ResonanceStreamer::IsPlaying(VoiceHandle handle) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return handle >= 0 && handle < static_cast<int>(voices_.size()) &&
+         voices_[handle].playing;
+}
+
+double ResonanceStreamer::GetPosition(VoiceHandle handle) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (handle < 0 || handle >= static_cast<int>(voices_.size()) || !voices_[handle].used) {
+    return 0.0;
+  }
+  const Voice& voice = voices_[handle];
+  return voice.position / voice.clip->sample_rate;
+}
+
+void ResonanceStreamer::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const int sample_rate = world_->sample_rate();
+    if (sample_rate > 0) {
+      for (Voice& voice : voices_) {
+        if (voice.playing) {
+          Fill(&voice, sample_rate);
+        }
+      }
+    }
+    wake_.wait_for(lock, kPrefetchInterval);
+  }
+}
+
+void ResonanceStreamer::Fill(Voice* voice, int sample_rate) {
+  size_t space = world_->GetInputSpace(voice->left);
+  if (voice->right != ResonanceWorld::kInvalidSourceHandle) {
+    space = std::min(space, world_->GetInputSpace(voice->right));
+  }
+  const size_t queued =
+      ResonanceWorld::kInputRingFrames - std::min(space, ResonanceWorld::kInputRingFrames);
+  if (queued >= kPrefetchFrames) {
+    return;
+  }
+  const double step = static_cast<double>(voice->clip->sample_rate) / sample_rate;
+  size_t num_frames = kPrefetchFrames - queued;
+  while (num_frames > 0 && voice->playing) {
+    const size_t chunk = std::min(num_frames, kChunkFrames);
+    const size_t produced = Resample(voice, step, chunk);
+    world_->PushInput(voice->left, left_.data(), produced);
+    if (voice->right != ResonanceWorld::kInvalidSourceHandle) {
+      world_->PushInput(voice->right, right_.data(), produced);
+    }
+    num_frames -= chunk;
+  }
+}
+
+size_t ResonanceStreamer::Resample(Voice* voice, double step, size_t num_frames) {
+  const StreamClip& clip = *voice->clip;
+  const size_t num_channels = clip.num_channels;
+  const float* samples = clip.samples.data();
+  const bool stereo_out = voice->right != ResonanceWorld::kInvalidSourceHandle;
+  double position = voice->position;
+  size_t frame = 0;
+  for (; frame < num_frames; ++frame) {
+    if (position >= static_cast<double>(clip.num_frames)) {
+      voice->playing = false;
+      break;
+    }
+    // Linear interpolation towards the next frame, which wraps at the end of
+    // the loop and holds at the end of the clip.
+    const size_t index = static_cast<size_t>(position);
+    const float fraction = static_cast<float>(position - index);
+    size_t next = index + 1;
+    if (clip.loop && next >= clip.loop_end) {
+      next = clip.loop_begin;
+    } else if (next >= clip.num_frames) {
+      next = index;
+    }
+    const float* a = samples + index * num_channels;
+    const float* b = samples + next * num_channels;
+    if (voice->num_channels > 1) {
+      // Soundfield: ambiX orders channels by degree, so dropping the trailing
+      // ones lowers the order and missing ones are silent.
+      float* out = left_.data() + frame * voice->num_channels;
+      const size_t shared = std::min(num_channels, voice->num_channels);
+      for (size_t channel = 0; channel < shared; ++channel) {
+        out[channel] = a[channel] + fraction * (b[channel] - a[channel]);
+      }
+      std::fill(out + shared, out + voice->num_channels, 0.0f);
+    } else {
+      const float left = a[0] + fraction * (b[0] - a[0]);
+      const float right = num_channels > 1 ? a[1] + fraction * (b[1] - a[1]) : left;
+      if (stereo_out) {
+        left_[frame] = left;
+        right_[frame] = right;
+      } else {
+        // A multichannel clip on a mono source plays its first channel, the
+        // omnidirectional one of an ambiX clip.
+        left_[frame] = num_channels == 2 ? 0.5f * (left + right) : left;
+      }
+    }
+
+    position += step;
+    if (clip.loop && position >= static_cast<double>(clip.loop_end)) {
+      position -= static_cast<double>(clip.loop_end - clip.loop_begin);
+    }
+  }
+  voice->position = position;
+  return frame;
+}
@@ -0,0 +1,100 @@
+#ifndef GDRESONANCE_RESONANCE_STREAMER_H
+#define GDRESONANCE_RESONANCE_STREAMER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "resonance_world.h"
+
+// Decoded audio clip, immutable once handed to the streamer so that any
+// number of voices can share it.
+struct StreamClip {
+  // Interleaved frames.
+  std::vector<float> samples;
+  size_t num_channels;
+  size_t num_frames;
+  int sample_rate;
+  // Looping plays [loop_begin, loop_end) once the end of the loop is reached;
+  // only set with a non-empty range within the clip.
+  bool loop;
+  size_t loop_begin;
+  size_t loop_end;
+};
+
+// Plays clips into the input rings of world sources. A worker thread resamples
+// every playing clip to the rate of the world and keeps kPrefetchFrames frames
+// queued ahead of the renderer, so the audio thread only reads the rings.
+//
+// The ring of a source takes a single producer: a source fed by the streamer
+// must not be fed through PushInput() by anything else.
+class ResonanceStreamer {
+public:
+    typedef int VoiceHandle;
+    static const VoiceHandle kInvalidVoiceHandle = -1;
+
+    // Frames kept queued per source, about 40 ms at 48 kHz.
+    static const size_t kPrefetchFrames = 2048;
+
+    explicit ResonanceStreamer(ResonanceWorld* world);
+    ~ResonanceStreamer();
+
+    // Input channels of the widest source the streamer feeds, a third order
+    // soundfield.
+    static const size_t kMaxChannels = 16;
+
+    // Starts |clip| at |position| seconds. With a valid |right| the first two
+    // channels of the clip go to their own sources. Otherwise a mono |left|
+    // gets the clip mixed down, and a soundfield |left| gets the leading
+    // channels of the clip, which truncates ambiX clips to its order.
+    VoiceHandle Play(std::shared_ptr<const StreamClip> clip, ResonanceWorld::SourceHandle left,
+                     ResonanceWorld::SourceHandle right, double position);
+
+    // Stops the voice. Once this returns the sources are not written anymore.
+    void Stop(VoiceHandle handle);
+
+    // Whether the voice has frames left to queue. Looping voices play until
+    // stopped.
+    bool IsPlaying(VoiceHandle handle) const;
+
+    // Position in seconds of the next frame the voice queues.
+    double GetPosition(VoiceHandle handle) const;
+
+private:
+    struct Voice {
+      bool used;
+      bool playing;
+      std::shared_ptr<const StreamClip> clip;
+      ResonanceWorld::SourceHandle left;
+      ResonanceWorld::SourceHandle right;
+      // Input channels of |left|.
+      size_t num_channels;
+      // Read position in clip frames.
+      double position;
+    };
+
+    // Frames resampled per PushInput().
+    static const size_t kChunkFrames = 256;
+
+    void Loop();
+    // Tops up the rings of |voice|. Requires |mutex_|.
+    void Fill(Voice* voice, int sample_rate);
+    // Resamples up to |num_frames| frames of |voice| at |step| clip frames per
+    // output frame into |left_|, interleaved, and |right_|. Returns the frames produced.
+    size_t Resample(Voice* voice, double step, size_t num_frames);
+
+    ResonanceWorld* world_;
+    // Guards |voices_| and |stop_|; the worker holds it while filling.
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread worker_;
+    bool stop_;
+    std::vector<Voice> voices_;
+    std::vector<float> left_;
+    std::vector<float> right_;
+};
+
+#endif // GDRESONANCE_RESONANCE_STREAMER_H
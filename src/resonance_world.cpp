@@ -0,0 +1,1864 @@
+#include "resonance_world.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include "base/constants_and_types.h"
+#include "base/logging.h"
+#include "base/misc_math.h"
+#include "platforms/common/room_effects_utils.h"
+
+#include "audio_convert.h"
+#include "resonance_streamer.h"
+
+namespace {
+
+const size_t kNumOutputChannels = 2;
+
+// Relative cost of one sound object per rendering mode, indexed by
+// vraudio::RenderingMode. Binaural rendering is dominated by the ambisonic order
+// (16, 9 and 4 channels); stereo panning is close to free.
+const float kRenderingModeCost[] = {0.1f, 0.25f, 0.5625f, 1.0f};
+
+// How often the builder thread checks whether retired graphs can be freed.
+const std::chrono::milliseconds kReclaimInterval(100);
+
+// Sources are only moved to a cheaper mode once they are this much further
+// than the LOD distance, so they do not flap at the boundary.
+const float kLodHysteresis = 1.1f;
+
+// Reverb tails are rendered for this many RT60s after the last audible input,
+// by when they decayed by about 100 dB, below
+// ResonanceWorld::kSilenceThreshold. The reflections and HRTF filters ring
+// out within the extra kMinTailTime seconds.
+const float kTailRt60s = 1.7f;
+const float kMinTailTime = 0.1f;
+
+// Computed distance attenuations that changed by less than this are not
+// handed to the graph, which ramps the gain of a source anyway.
+const float kAttenuationEpsilon = 1e-4f;
+
+// Voiced sound objects keep their sources for this many blocks without input,
+// so that input arriving in bursts does not rebind them every other block.
+const int kVoiceHoldBlocks = 16;
+
+std::mutex worlds_mutex;
+std::map<std::string, std::unique_ptr<ResonanceWorld>> worlds;
+
+}  // namespace
+
+RenderGroup::RenderGroup(int sample_rate, size_t num_channels, size_t frames_per_buffer)
+    : api(vraudio::CreateResonanceAudioApi(num_channels, frames_per_buffer, sample_rate)),
+      num_sources(0),
+      output(num_channels * frames_per_buffer) {}
+
+ResonanceAudioSystem::ResonanceAudioSystem(int sample_rate, size_t num_channels,
+                                           size_t frames_per_buffer, int num_groups)
+    : sample_rate(sample_rate),
+      generation(0),
+      frames_per_buffer(frames_per_buffer),
+      pending_frames(0),
+      started(false),
+      primed(false) {
+  // Soundfields with up to third order ambisonics fit into the scratch buffer.
+  input_buffer.resize(frames_per_buffer * 16);
+  // A primed block plus at most one block rendered ahead of the driver.
+  output_ring.Allocate(num_channels, 3 * frames_per_buffer);
+  output_buffer.resize(num_channels * frames_per_buffer);
+  for (int i = 0; i < num_groups; ++i) {
+    groups.emplace_back(new RenderGroup(sample_rate, num_channels, frames_per_buffer));
+  }
+  // The audio thread renders one group itself.
+  if (num_groups > 1) {
+    workers.reset(new RenderPool(num_groups - 1));
+  }
+}
+
+void ResonanceWorld::ResetParams(SourceParams* params) {
+  params->position[0] = params->position[1] = params->position[2] = 0.0f;
+  params->rotation[0] = params->rotation[1] = params->rotation[2] = 0.0f;
+  params->rotation[3] = 1.0f;
+  params->gain = 1.0f;
+  params->directivity[0] = params->directivity[1] = 0.0f;
+  params->listener_directivity[0] = params->listener_directivity[1] = 0.0f;
+  params->distance_attenuation = 1.0f;
+  params->near_field_effect_gain = 0.0f;
+  params->occlusion = 0.0f;
+  params->room_effects_gain = 1.0f;
+  params->spread = 0.0f;
+  params->priority = 1.0f;
+  params->distance_model = kDistanceModelNone;
+  params->min_distance = 1.0f;
+  params->max_distance = 500.0f;
+  params->requested_distance_attenuation = 1.0f;
+  params->requested_near_field_gain = 0.0f;
+}
+
+void ResonanceWorld::SourceSlot::ResetAudioState() {
+  ResetParams(&params);
+  voice = kVoiceVirtual;
+  render_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+  render_mode = rendering_mode;
+  group = 0;
+  room_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+  lod = kRenderingModeAuto;
+  next_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+  next_mode = rendering_mode;
+  fade_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+  fade_mode = rendering_mode;
+  starved_blocks = 0;
+  dirty = false;
+}
+
+ResonanceWorld::ResonanceWorld()
+    : slots_(new SourceSlot[kMaxSources]),
+      builder_stop_(false),
+      build_pending_(false),
+      num_groups_(1),
+      build_serial_(0),
+      last_generation_(0),
+      sample_rate_(0),
+      render_epoch_(0),
+      room_revision_(0),
+      room_lookup_pending_(false),
+      listener_room_(kInvalidRoomHandle),
+      room_fade_step_(kRoomFadeSteps),
+      room_revision_pushed_(0),
+      rendered_generation_(0),
+      listener_gain_(1.0f),
+      stereo_speaker_mode_(false),
+      max_voices_(kDefaultMaxVoices),
+      voice_candidates_(new VoiceCandidate[kMaxSources]),
+      lod_budget_(16.0f),
+      source_table_(kMaxSources),
+      idle_(false),
+      tail_remaining_(0),
+      world_dirty_(false),
+      total_blocks_(0),
+      late_blocks_(0),
+      underruns_(0),
+      peak_render_time_(0.0f),
+      dropped_updates_(0),
+      late_updates_(0),
+      stats_window_(new RenderStats[kStatsWindow]),
+      stats_scratch_(new RenderStats[kStatsWindow]),
+      stats_window_next_(0),
+      stats_window_size_(0),
+      streamer_(new ResonanceStreamer(this)),
+      renderer_(nullptr) {
+  listener_position_[0] = listener_position_[1] = listener_position_[2] = 0.0f;
+  listener_rotation_[0] = listener_rotation_[1] = listener_rotation_[2] = 0.0f;
+  listener_rotation_[3] = 1.0f;
+  room_.enabled = false;
+  game_listener_position_[0] = game_listener_position_[1] = game_listener_position_[2] = 0.0f;
+  room_fade_from_.enabled = false;
+  room_command_.enabled = false;
+  lod_distances_[0] = 5.0f;
+  lod_distances_[1] = 15.0f;
+  lod_distances_[2] = 40.0f;
+  for (size_t i = 0; i < DistanceCurve::kNumPoints; ++i) {
+    distance_curve_.gains[i] = 1.0f - static_cast<float>(i) / (DistanceCurve::kNumPoints - 1);
+  }
+  std::fill(pool_sizes_, pool_sizes_ + kNumPooledRenderingModes, kDefaultSourcePoolSize);
+  soundfield_pool_size_ = kDefaultSoundfieldPoolSize;
+  std::memset(&render_stats_, 0, sizeof(render_stats_));
+}
+
+ResonanceWorld::~ResonanceWorld() {
+  // Stops writing into the sources before they go away.
+  streamer_.reset();
+  Shutdown();
+  if (builder_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(graph_mutex_);
+      builder_stop_ = true;
+    }
+    builder_wake_.notify_one();
+    builder_.join();
+  }
+}
+
+ResonanceWorld* ResonanceWorld::Get(const std::string& name) {
+  std::lock_guard<std::mutex> lock(worlds_mutex);
+  std::unique_ptr<ResonanceWorld>& world = worlds[name];
+  if (world == nullptr) {
+    world.reset(new ResonanceWorld());
+  }
+  return world.get();
+}
+
+void ResonanceWorld::ReleaseAll() {
+  std::lock_guard<std::mutex> lock(worlds_mutex);
+  worlds.clear();
+}
+
+bool ResonanceWorld::AttachRenderer(const void* renderer) {
+  renderers_.push_back(renderer);
+  renderer_.store(renderer, std::memory_order_release);
+  return renderers_.size() == 1;
+}
+
+bool ResonanceWorld::DetachRenderer(const void* renderer) {
+  renderers_.erase(std::remove(renderers_.begin(), renderers_.end(), renderer),
+                   renderers_.end());
+  if (renderer_.load(std::memory_order_relaxed) == renderer) {
+    renderer_.store(renderers_.empty() ? nullptr : renderers_.back(),
+                    std::memory_order_release);
+  }
+  return renderers_.empty();
+}
+
+bool ResonanceWorld::IsRenderer(const void* renderer) const {
+  return renderer_.load(std::memory_order_acquire) == renderer;
+}
+
+std::shared_ptr<ResonanceAudioSystem> ResonanceWorld::system() const {
+  return std::atomic_load(&system_);
+}
+
+void ResonanceWorld::Initialize(int sample_rate, size_t num_channels,
+                                size_t frames_per_buffer) {
+  CHECK_GE(sample_rate, 0);
+  CHECK_EQ(num_channels, kNumOutputChannels);
+  CHECK_GE(frames_per_buffer, 0);
+  sample_rate_.store(sample_rate, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(graph_mutex_);
+    build_request_.sample_rate = sample_rate;
+    build_request_.num_channels = num_channels;
+    build_request_.frames_per_buffer = frames_per_buffer;
+    std::copy(pool_sizes_, pool_sizes_ + kNumPooledRenderingModes, build_request_.pool_sizes);
+    build_request_.soundfield_pool_size = soundfield_pool_size_;
+    build_request_.num_groups = num_groups_;
+    build_pending_ = true;
+    ++build_serial_;
+    if (!builder_.joinable()) {
+      builder_ = std::thread(&ResonanceWorld::BuilderLoop, this);
+    }
+  }
+  builder_wake_.notify_one();
+}
+
+void ResonanceWorld::Shutdown() {
+  std::vector<RetiredSystem> retired;
+  {
+    std::lock_guard<std::mutex> lock(graph_mutex_);
+    build_pending_ = false;
+    ++build_serial_;
+    // The last renderer is gone, so the audio thread holds no graph anymore
+    // and everything can be released right here.
+    std::atomic_store(&system_, std::shared_ptr<ResonanceAudioSystem>());
+    retired.swap(retired_systems_);
+    // Without a graph nothing renders anymore, so retired slots can be freed here.
+    for (int i = 0; i < kMaxSources; ++i) {
+      int retiring = kSlotRetiring;
+      slots_[i].state.compare_exchange_strong(retiring, kSlotFree, std::memory_order_acq_rel);
+    }
+  }
+  sample_rate_.store(0, std::memory_order_relaxed);
+}
+
+void ResonanceWorld::SetSourcePoolSize(vraudio::RenderingMode rendering_mode, int size) {
+  if (rendering_mode < 0 || rendering_mode >= kNumPooledRenderingModes) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  pool_sizes_[rendering_mode] = std::max(size, 0);
+}
+
+int ResonanceWorld::GetSourcePoolSize(vraudio::RenderingMode rendering_mode) {
+  if (rendering_mode < 0 || rendering_mode >= kNumPooledRenderingModes) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  return pool_sizes_[rendering_mode];
+}
+
+void ResonanceWorld::SetSoundfieldPoolSize(int size) {
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  soundfield_pool_size_ = std::max(size, 0);
+}
+
+int ResonanceWorld::GetSoundfieldPoolSize() {
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  return soundfield_pool_size_;
+}
+
+void ResonanceWorld::SetRenderGroups(int count) {
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  num_groups_ = std::min(std::max(count, 1), kMaxRenderGroups);
+}
+
+int ResonanceWorld::GetRenderGroups() {
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  return num_groups_;
+}
+
+int ResonanceWorld::sample_rate() const {
+  return sample_rate_.load(std::memory_order_relaxed);
+}
+
+bool ResonanceWorld::HasGraph() const {
+  return system() != nullptr;
+}
+
+void ResonanceWorld::BuilderLoop() {
+  std::unique_lock<std::mutex> lock(graph_mutex_);
+  while (!builder_stop_) {
+    if (build_pending_) {
+      const BuildRequest request = build_request_;
+      const uint64_t serial = build_serial_;
+      build_pending_ = false;
+      lock.unlock();
+      Build(request, serial);
+      lock.lock();
+      continue;
+    }
+
+    // Free the graphs the audio thread has moved past. They are destroyed
+    // outside of the lock.
+    std::vector<std::shared_ptr<ResonanceAudioSystem>> reclaimed;
+    const uint64_t epoch = render_epoch_.load();
+    for (auto it = retired_systems_.begin(); it != retired_systems_.end();) {
+      if (it->epoch < epoch) {
+        reclaimed.push_back(std::move(it->system));
+        it = retired_systems_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (!reclaimed.empty()) {
+      lock.unlock();
+      reclaimed.clear();
+      lock.lock();
+      continue;
+    }
+
+    builder_wake_.wait_for(lock, kReclaimInterval);
+  }
+}
+
+void ResonanceWorld::Build(const BuildRequest& request, uint64_t build_serial) {
+  // The expensive part (HRTF and FFT setup, the source pools) runs without
+  // holding the lock.
+  auto system = std::make_shared<ResonanceAudioSystem>(
+      request.sample_rate, request.num_channels, request.frames_per_buffer, request.num_groups);
+  const int num_groups = static_cast<int>(system->groups.size());
+  int num_room_sources = 0;
+  for (int i = 0; i < num_groups; ++i) {
+    RenderGroup* group = system->groups[i].get();
+    for (int mode = 0; mode < kNumPooledRenderingModes; ++mode) {
+      auto& pool = group->source_pools[mode];
+      // The groups share the pooled sources. Every slot may hold a source of
+      // any mode, plus one in a handover.
+      const int size = (request.pool_sizes[mode] + num_groups - 1) / num_groups;
+      pool.reserve(size + 2 * kMaxSources);
+      for (int j = 0; j < size; ++j) {
+        pool.push_back(
+            CreateSoundObject(group->api.get(), static_cast<vraudio::RenderingMode>(mode)));
+      }
+      num_room_sources += i > 0 ? size : 0;
+    }
+  }
+  if (num_groups > 1) {
+    // One room copy per pooled source outside of group 0.
+    RenderGroup* group = system->groups[0].get();
+    group->room_pool.reserve(kMaxSources);
+    for (int j = 0; j < std::min(num_room_sources, kMaxSources); ++j) {
+      group->room_pool.push_back(CreateSoundObject(group->api.get(), vraudio::kRoomEffectsOnly));
+    }
+  }
+  RenderGroup* main_group = system->groups[0].get();
+  for (int order = 1; order <= kNumPooledAmbisonicOrders; ++order) {
+    auto& pool = main_group->soundfield_pools[order - 1];
+    pool.reserve(request.soundfield_pool_size + kMaxSources);
+    for (int j = 0; j < request.soundfield_pool_size; ++j) {
+      const auto id = main_group->api->CreateAmbisonicSource((order + 1) * (order + 1));
+      main_group->api->SetSourceVolume(id, 0.0f);
+      pool.push_back(id);
+    }
+  }
+  // ResonanceAudio sets up sources in tasks run by the next render call. Run
+  // one silent block here so that this happens on the builder thread rather
+  // than on the audio thread.
+  for (const auto& group : system->groups) {
+    group->api->FillInterleavedOutputBuffer(request.num_channels, request.frames_per_buffer,
+                                            group->output.data());
+  }
+
+  std::lock_guard<std::mutex> lock(graph_mutex_);
+  if (build_serial != build_serial_) {
+    // Superseded by another Initialize() or cancelled by Shutdown(). The
+    // graph was never published and can go right away.
+    return;
+  }
+  system->generation = ++last_generation_;
+  Retire(std::atomic_exchange(&system_, system));
+}
+
+void ResonanceWorld::Retire(std::shared_ptr<ResonanceAudioSystem> system) {
+  if (system == nullptr) {
+    return;
+  }
+  retired_systems_.push_back({std::move(system), render_epoch_.load()});
+}
+
+vraudio::ResonanceAudioApi::SourceId ResonanceWorld::CreateSoundObject(
+    vraudio::ResonanceAudioApi* api, vraudio::RenderingMode rendering_mode) {
+  const auto id = api->CreateSoundObjectSource(rendering_mode);
+  api->SetSourceDistanceModel(id, vraudio::DistanceRolloffModel::kNone, 0.0f, 0.0f);
+  // Sound objects start out virtual and ramp up once they get a voice.
+  api->SetSourceVolume(id, 0.0f);
+  return id;
+}
+
+std::vector<vraudio::ResonanceAudioApi::SourceId>* ResonanceWorld::SourcePool(
+    RenderGroup* group, int rendering_mode) {
+  if (rendering_mode == vraudio::kRoomEffectsOnly) {
+    return &group->room_pool;
+  }
+  if (rendering_mode >= 0 && rendering_mode < kNumPooledRenderingModes) {
+    return &group->source_pools[rendering_mode];
+  }
+  return nullptr;
+}
+
+vraudio::ResonanceAudioApi::SourceId ResonanceWorld::AcquireSoundObject(RenderGroup* group,
+                                                                        int rendering_mode) {
+  auto* pool = SourcePool(group, rendering_mode);
+  if (pool != nullptr && !pool->empty()) {
+    const auto id = pool->back();
+    pool->pop_back();
+    return id;
+  }
+  return CreateSoundObject(group->api.get(),
+                           static_cast<vraudio::RenderingMode>(rendering_mode));
+}
+
+void ResonanceWorld::ReleaseSoundObject(RenderGroup* group,
+                                        vraudio::ResonanceAudioApi::SourceId id,
+                                        int rendering_mode) {
+  vraudio::ResonanceAudioApi* api = group->api.get();
+  auto* pool = SourcePool(group, rendering_mode);
+  if (pool == nullptr || pool->size() == pool->capacity()) {
+    api->DestroySource(id);
+    return;
+  }
+  // The next owner starts from the same state as a newly created source.
+  SourceParams params;
+  ResetParams(&params);
+  api->SetSourceVolume(id, 0.0f);
+  ApplyParams(api, id, params);
+  pool->push_back(id);
+}
+
+std::vector<vraudio::ResonanceAudioApi::SourceId>* ResonanceWorld::SoundfieldPool(
+    RenderGroup* group, size_t num_channels) {
+  for (int order = 1; order <= kNumPooledAmbisonicOrders; ++order) {
+    if (num_channels == static_cast<size_t>((order + 1) * (order + 1))) {
+      return &group->soundfield_pools[order - 1];
+    }
+  }
+  return nullptr;
+}
+
+vraudio::ResonanceAudioApi::SourceId ResonanceWorld::AcquireSoundfield(RenderGroup* group,
+                                                                       size_t num_channels) {
+  auto* pool = SoundfieldPool(group, num_channels);
+  if (pool != nullptr && !pool->empty()) {
+    const auto id = pool->back();
+    pool->pop_back();
+    return id;
+  }
+  return group->api->CreateAmbisonicSource(num_channels);
+}
+
+void ResonanceWorld::ReleaseSoundfield(RenderGroup* group,
+                                       vraudio::ResonanceAudioApi::SourceId id,
+                                       size_t num_channels) {
+  auto* pool = SoundfieldPool(group, num_channels);
+  if (pool == nullptr || pool->size() == pool->capacity()) {
+    group->api->DestroySource(id);
+    return;
+  }
+  // The next owner sets the rotation and the gain when it picks it up.
+  group->api->SetSourceVolume(id, 0.0f);
+  pool->push_back(id);
+}
+
+void ResonanceWorld::BindSoundObject(ResonanceAudioSystem* system, SourceSlot* slot,
+                                     int rendering_mode) {
+  RenderGroup* main_group = system->groups[0].get();
+  // Group 0 also renders the room and the soundfields, so ties go to the
+  // later groups.
+  slot->group = 0;
+  for (int g = 1; g < static_cast<int>(system->groups.size()); ++g) {
+    if (system->groups[g]->num_sources <= system->groups[slot->group]->num_sources) {
+      slot->group = g;
+    }
+  }
+  RenderGroup* group = system->groups[slot->group].get();
+  group->num_sources++;
+  slot->render_mode = rendering_mode;
+  slot->render_id = AcquireSoundObject(group, rendering_mode);
+  ApplyParams(group->api.get(), slot->render_id, slot->params);
+  if (slot->group != 0) {
+    slot->room_id = AcquireSoundObject(main_group, vraudio::kRoomEffectsOnly);
+    ApplyParams(main_group->api.get(), slot->room_id, slot->params);
+  }
+}
+
+void ResonanceWorld::ReleaseSources(ResonanceAudioSystem* system, SourceSlot* slot) {
+  if (slot->render_id == vraudio::ResonanceAudioApi::kInvalidSourceId &&
+      slot->next_id == vraudio::ResonanceAudioApi::kInvalidSourceId &&
+      slot->fade_id == vraudio::ResonanceAudioApi::kInvalidSourceId &&
+      slot->room_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    // Never picked up by this graph.
+    return;
+  }
+  RenderGroup* group = system->groups[slot->group].get();
+  const vraudio::ResonanceAudioApi::SourceId ids[] = {slot->render_id, slot->next_id,
+                                                      slot->fade_id};
+  const int modes[] = {slot->render_mode, slot->next_mode, slot->fade_mode};
+  for (int i = 0; i < 3; ++i) {
+    if (ids[i] == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      continue;
+    }
+    if (slot->is_soundfield) {
+      ReleaseSoundfield(group, ids[i], slot->num_channels);
+    } else {
+      ReleaseSoundObject(group, ids[i], modes[i]);
+    }
+  }
+  if (slot->room_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    ReleaseSoundObject(system->groups[0].get(), slot->room_id, vraudio::kRoomEffectsOnly);
+  }
+  if (slot->render_id != vraudio::ResonanceAudioApi::kInvalidSourceId && !slot->is_soundfield) {
+    group->num_sources--;
+  }
+  slot->render_id = slot->next_id = slot->fade_id = slot->room_id =
+      vraudio::ResonanceAudioApi::kInvalidSourceId;
+}
+
+void ResonanceWorld::SetVoiceVolume(ResonanceAudioSystem* system, const SourceSlot& slot,
+                                    float gain) {
+  system->groups[slot.group]->api->SetSourceVolume(slot.render_id, gain);
+  if (slot.room_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    system->groups[0]->api->SetSourceVolume(slot.room_id, gain);
+  }
+}
+
+ResonanceWorld::SourceHandle ResonanceWorld::AddSlot(vraudio::RenderingMode rendering_mode,
+                                                     size_t num_channels,
+                                                     bool is_soundfield) {
+  for (int i = 0; i < kMaxSources; ++i) {
+    SourceSlot& slot = slots_[i];
+    if (slot.state.load(std::memory_order_acquire) != kSlotFree) {
+      continue;
+    }
+    slot.rendering_mode = rendering_mode;
+    slot.num_channels = num_channels;
+    slot.is_soundfield = is_soundfield;
+    slot.position[0] = slot.position[1] = slot.position[2] = 0.0f;
+    slot.stereo_right = kInvalidSourceHandle;
+    slot.stereo_width = 0.0f;
+    slot.ResetAudioState();
+    if (slot.input.num_channels() != num_channels) {
+      slot.input.Allocate(num_channels, kInputRingFrames);
+    } else {
+      slot.input.Skip(slot.input.AvailableRead());
+    }
+    // The audio thread takes a source from the graph when it picks the slot up.
+    slot.state.store(kSlotActive, std::memory_order_release);
+    return i;
+  }
+  LOG(WARNING) << "Out of source slots";
+  return kInvalidSourceHandle;
+}
+
+ResonanceWorld::SourceHandle ResonanceWorld::AddSource(vraudio::RenderingMode rendering_mode) {
+  return AddSlot(rendering_mode, vraudio::kNumMonoChannels, false);
+}
+
+ResonanceWorld::SourceHandle ResonanceWorld::AddSoundfield(size_t num_channels) {
+  return AddSlot(vraudio::kBinauralHighQuality, num_channels, true);
+}
+
+void ResonanceWorld::RemoveSource(SourceHandle handle) {
+  if (handle < 0 || handle >= kMaxSources) {
+    return;
+  }
+  int active = kSlotActive;
+  slots_[handle].state.compare_exchange_strong(active, kSlotRetiring,
+                                               std::memory_order_acq_rel);
+}
+
+size_t ResonanceWorld::PushInput(SourceHandle handle, const float* input,
+                                 size_t num_frames) {
+  CHECK(input != nullptr);
+  if (handle < 0 || handle >= kMaxSources ||
+      slots_[handle].state.load(std::memory_order_acquire) != kSlotActive) {
+    return 0;
+  }
+  return slots_[handle].input.Write(input, num_frames);
+}
+
+size_t ResonanceWorld::GetInputSpace(SourceHandle handle) const {
+  if (handle < 0 || handle >= kMaxSources ||
+      slots_[handle].state.load(std::memory_order_acquire) != kSlotActive) {
+    return 0;
+  }
+  return slots_[handle].input.AvailableWrite();
+}
+
+size_t ResonanceWorld::GetInputChannels(SourceHandle handle) const {
+  if (handle < 0 || handle >= kMaxSources ||
+      slots_[handle].state.load(std::memory_order_acquire) != kSlotActive) {
+    return 0;
+  }
+  return slots_[handle].num_channels;
+}
+
+void ResonanceWorld::Render(size_t num_frames, float* output) {
+  CHECK(output != nullptr);
+
+  // Counted before the graph is loaded, see RetiredSystem.
+  render_epoch_.fetch_add(1);
+  auto system_copy = system();
+  if (system_copy == nullptr) {
+    std::fill(output, output + kNumOutputChannels * num_frames, 0.0f);
+    return;
+  }
+  ResonanceAudioSystem* system = system_copy.get();
+  const size_t block = system->frames_per_buffer;
+  const auto start = std::chrono::steady_clock::now();
+  render_stats_.audio_time = static_cast<float>(num_frames) / system->sample_rate;
+  render_stats_.underruns = 0;
+  render_stats_.updates = 0;
+  render_stats_.idle_time = 0.0f;
+
+  if (system->generation != rendered_generation_) {
+    // A new graph was swapped in. The sources of the old one died with it;
+    // the slots are picked up again like new ones, which hands the sources of
+    // the new graph the mirrored parameters.
+    rendered_generation_ = system->generation;
+    for (int i = 0; i < kMaxSources; ++i) {
+      SourceSlot& slot = slots_[i];
+      // Free slots belong to the game thread, which resets them when adding.
+      if (slot.state.load(std::memory_order_acquire) == kSlotFree) {
+        continue;
+      }
+      // The new graph may have fewer groups; slots retired before the next
+      // voice pass must not reach into a group that is gone.
+      slot.render_id = slot.next_id = slot.fade_id = slot.room_id =
+          vraudio::ResonanceAudioApi::kInvalidSourceId;
+      slot.group = 0;
+      slot.voice = kVoiceVirtual;
+      slot.starved_blocks = 0;
+      slot.dirty = false;
+    }
+    ApplyWorldState(system);
+    // The new graph starts out awake and renders at least one tail.
+    idle_ = false;
+    world_dirty_ = false;
+    tail_remaining_ = TailFrames(system->sample_rate);
+  }
+
+  // Parameter updates are applied once per driver block, before any rendering.
+  ApplyPending(system);
+
+  if (!system->started) {
+    // Deciding per call would prime a block of silence into the middle of the
+    // stream the first time an odd call comes along.
+    system->started = true;
+    if (num_frames % block != 0) {
+      std::fill(system->output_buffer.begin(), system->output_buffer.end(), 0.0f);
+      system->output_ring.Write(system->output_buffer.data(), block);
+      system->primed = true;
+    }
+  }
+
+  while (num_frames > 0) {
+    const size_t frames = std::min(num_frames, block);
+    if (!system->primed) {
+      // Driver and graph agree on the block size, render in place. The frames
+      // of a block rendered ahead go out first.
+      const size_t ahead = system->output_ring.Read(output, frames);
+      if (ahead == 0 && frames == block) {
+        RenderBlock(system, output);
+      } else if (ahead < frames) {
+        RenderBlock(system, system->output_buffer.data());
+        const size_t rest = frames - ahead;
+        std::copy(system->output_buffer.begin(),
+                  system->output_buffer.begin() + kNumOutputChannels * rest,
+                  output + kNumOutputChannels * ahead);
+        system->output_ring.Write(system->output_buffer.data() + kNumOutputChannels * rest,
+                                  block - rest);
+      }
+    } else {
+      system->pending_frames += frames;
+      while (system->pending_frames >= block) {
+        RenderBlock(system, system->output_buffer.data());
+        system->output_ring.Write(system->output_buffer.data(), block);
+        system->pending_frames -= block;
+      }
+      system->output_ring.Read(output, frames);
+    }
+    output += kNumOutputChannels * frames;
+    num_frames -= frames;
+  }
+
+  render_stats_.idle = idle_ ? 1 : 0;
+  const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+  RecordStats(elapsed.count());
+}
+
+void ResonanceWorld::RecordStats(float render_time) {
+  render_stats_.render_time = render_time;
+  stats_ring_.Write(render_stats_);
+  total_blocks_.fetch_add(1, std::memory_order_relaxed);
+  if (render_time > render_stats_.audio_time) {
+    late_blocks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (render_stats_.underruns > 0) {
+    underruns_.fetch_add(render_stats_.underruns, std::memory_order_relaxed);
+  }
+  // Only the audio thread writes the peak.
+  if (render_time > peak_render_time_.load(std::memory_order_relaxed)) {
+    peak_render_time_.store(render_time, std::memory_order_relaxed);
+  }
+}
+
+void ResonanceWorld::GetStats(ResonanceStats* stats) {
+  const size_t count = stats_ring_.Read(stats_scratch_.get(), kStatsWindow);
+  for (size_t i = 0; i < count; ++i) {
+    stats_window_[stats_window_next_] = stats_scratch_[i];
+    stats_window_next_ = (stats_window_next_ + 1) % kStatsWindow;
+  }
+  stats_window_size_ = std::min(stats_window_size_ + static_cast<int>(count), kStatsWindow);
+
+  std::memset(stats, 0, sizeof(*stats));
+  stats->blocks = stats_window_size_;
+  float render_time = 0.0f;
+  float audio_time = 0.0f;
+  float idle_time = 0.0f;
+  float updates = 0.0f;
+  for (int i = 0; i < stats_window_size_; ++i) {
+    const RenderStats& block = stats_window_[i];
+    render_time += block.render_time;
+    audio_time += block.audio_time;
+    idle_time += block.idle_time;
+    updates += block.updates;
+    stats->max_render_time = std::max(stats->max_render_time, 1000.0f * block.render_time);
+  }
+  if (stats_window_size_ > 0) {
+    stats->render_time = 1000.0f * render_time / stats_window_size_;
+    stats->updates = updates / stats_window_size_;
+    stats->load = audio_time > 0.0f ? render_time / audio_time : 0.0f;
+    stats->idle_time = audio_time > 0.0f ? idle_time / audio_time : 0.0f;
+    const RenderStats& latest =
+        stats_window_[(stats_window_next_ + kStatsWindow - 1) % kStatsWindow];
+    std::copy(latest.sources, latest.sources + kNumPooledRenderingModes, stats->sources);
+    stats->soundfields = latest.soundfields;
+    stats->virtual_sources = latest.virtual_sources;
+    stats->silent_sources = latest.silent_sources;
+    stats->idle = latest.idle != 0;
+  }
+  stats->total_blocks = total_blocks_.load(std::memory_order_relaxed);
+  stats->late_blocks = late_blocks_.load(std::memory_order_relaxed);
+  stats->underruns = underruns_.load(std::memory_order_relaxed);
+  stats->dropped_updates = dropped_updates_;
+  stats->late_updates = late_updates_;
+  stats->peak_render_time = 1000.0f * peak_render_time_.load(std::memory_order_relaxed);
+}
+
+void ResonanceWorld::WriteSourceRow(int index) {
+  const SourceParams& params = slots_[index].params;
+  SourceTable& table = source_table_;
+  table.x[index] = params.position[0];
+  table.y[index] = params.position[1];
+  table.z[index] = params.position[2];
+  // The -z axis of the source rotation.
+  const float* q = params.rotation;
+  table.forward_x[index] = -2.0f * (q[0] * q[2] + q[3] * q[1]);
+  table.forward_y[index] = -2.0f * (q[1] * q[2] - q[3] * q[0]);
+  table.forward_z[index] = -(1.0f - 2.0f * (q[0] * q[0] + q[1] * q[1]));
+  table.directivity_alpha[index] = params.directivity[0];
+  table.directivity_order[index] = params.directivity[1];
+  table.gain[index] = params.gain;
+  table.priority[index] = params.priority;
+  table.occlusion[index] = params.occlusion;
+  table.model[index] = params.distance_model;
+  table.min_distance[index] = params.min_distance;
+  table.max_distance[index] = params.max_distance;
+  table.near_field_gain[index] = params.requested_near_field_gain;
+}
+
+void ResonanceWorld::UpdateDistances(ResonanceAudioSystem* system) {
+  for (int i = 0; i < kMaxSources; ++i) {
+    const SourceSlot& slot = slots_[i];
+    // Slots added since the last block start from parameters that did not
+    // go through Apply().
+    if (slot.render_id == vraudio::ResonanceAudioApi::kInvalidSourceId &&
+        slot.state.load(std::memory_order_acquire) == kSlotActive) {
+      WriteSourceRow(i);
+    }
+  }
+
+  UpdateSourceTable(&source_table_, listener_position_, distance_curve_);
+
+  vraudio::ResonanceAudioApi* main_api = system->groups[0]->api.get();
+  for (int i = 0; i < kMaxSources; ++i) {
+    SourceSlot& slot = slots_[i];
+    SourceParams& params = slot.params;
+    if (params.distance_model == kDistanceModelNone || slot.is_soundfield ||
+        slot.state.load(std::memory_order_acquire) != kSlotActive) {
+      continue;
+    }
+    const float attenuation = source_table_.attenuation[i];
+    const float near_field = source_table_.near_field[i];
+    const bool attenuation_changed =
+        std::fabs(attenuation - params.distance_attenuation) > kAttenuationEpsilon;
+    const bool near_field_changed = near_field != params.near_field_effect_gain;
+    if (!attenuation_changed && !near_field_changed) {
+      continue;
+    }
+    if (attenuation_changed) {
+      params.distance_attenuation = attenuation;
+    }
+    params.near_field_effect_gain = near_field;
+    // Sources not picked up yet get all parameters from the voice update.
+    if (slot.render_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      continue;
+    }
+    vraudio::ResonanceAudioApi* api = system->groups[slot.group]->api.get();
+    const vraudio::ResonanceAudioApi::SourceId ids[] = {slot.render_id, slot.next_id,
+                                                        slot.room_id};
+    for (int j = 0; j < 3; ++j) {
+      if (ids[j] == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+        continue;
+      }
+      // The room copy lives in group 0.
+      vraudio::ResonanceAudioApi* target = j == 2 ? main_api : api;
+      if (attenuation_changed) {
+        ApplyParam(target, ids[j], ResonanceCommand::kSourceDistanceAttenuation, params);
+      }
+      if (near_field_changed) {
+        ApplyParam(target, ids[j], ResonanceCommand::kSourceNearFieldEffectGain, params);
+      }
+    }
+  }
+}
+
+int ResonanceWorld::UpdateVoices(ResonanceAudioSystem* system) {
+  RenderGroup* main_group = system->groups[0].get();
+
+  int num_candidates = 0;
+  for (int i = 0; i < kMaxSources; ++i) {
+    SourceSlot& slot = slots_[i];
+    if (slot.state.load(std::memory_order_acquire) != kSlotActive) {
+      continue;
+    }
+    const bool bound = slot.render_id != vraudio::ResonanceAudioApi::kInvalidSourceId;
+    if (slot.is_soundfield) {
+      // Ambience beds are not positioned and always keep their voice.
+      if (!bound) {
+        slot.group = 0;
+        slot.voice = kVoiceAudible;
+        const auto id = AcquireSoundfield(main_group, slot.num_channels);
+        slot.render_id = id;
+        ApplyParam(main_group->api.get(), id, ResonanceCommand::kSourceTransform, slot.params);
+        main_group->api->SetSourceVolume(id, slot.params.gain);
+      }
+      continue;
+    }
+    // Sound objects compete for a voice only while they have pending input.
+    if (slot.input.AvailableRead() > 0) {
+      slot.starved_blocks = 0;
+      voice_candidates_[num_candidates].audibility = source_table_.audibility[i];
+      voice_candidates_[num_candidates].slot = i;
+      ++num_candidates;
+    } else if (bound && ++slot.starved_blocks > kVoiceHoldBlocks) {
+      ReleaseSources(system, &slot);
+      slot.voice = kVoiceVirtual;
+    }
+  }
+
+  const int num_voices = std::min(num_candidates, max_voices_);
+  std::partial_sort(voice_candidates_.get(), voice_candidates_.get() + num_voices,
+                    voice_candidates_.get() + num_candidates,
+                    [](const VoiceCandidate& a, const VoiceCandidate& b) {
+                      return a.audibility > b.audibility;
+                    });
+
+  for (int i = 0; i < num_candidates; ++i) {
+    SourceSlot& slot = slots_[voice_candidates_[i].slot];
+    const bool bound = slot.render_id != vraudio::ResonanceAudioApi::kInvalidSourceId;
+    if (i < num_voices) {
+      // Slots without a source get one from UpdateLods(), in the mode the
+      // level of detail picks for them.
+      if (bound && slot.voice != kVoiceAudible) {
+        SetVoiceVolume(system, slot, slot.params.gain);
+      }
+      slot.voice = kVoiceAudible;
+    } else if (bound && slot.voice == kVoiceAudible) {
+      SetVoiceVolume(system, slot, 0.0f);
+      slot.voice = kVoiceFadingOut;
+    } else {
+      // The fade out is over; the pools get the sources back.
+      if (bound) {
+        ReleaseSources(system, &slot);
+      }
+      slot.voice = kVoiceVirtual;
+    }
+  }
+  return num_voices;
+}
+
+int ResonanceWorld::LodForDistance(float distance) const {
+  if (distance < lod_distances_[0]) {
+    return vraudio::kBinauralHighQuality;
+  }
+  if (distance < lod_distances_[1]) {
+    return vraudio::kBinauralMediumQuality;
+  }
+  if (distance < lod_distances_[2]) {
+    return vraudio::kBinauralLowQuality;
+  }
+  return vraudio::kStereoPanning;
+}
+
+void ResonanceWorld::UpdateLods(ResonanceAudioSystem* system, int num_voices) {
+  float budget = lod_budget_;
+  // Candidates are sorted, so the most audible sources pick their mode first.
+  for (int i = 0; i < num_voices; ++i) {
+    SourceSlot& slot = slots_[voice_candidates_[i].slot];
+    if (slot.render_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      // Just got its voice: bind it straight in its mode, no handover needed.
+      int mode = slot.lod;
+      if (mode == kRenderingModeAuto) {
+        const float distance = source_table_.distance[voice_candidates_[i].slot] /
+                               std::max(slot.params.priority, 1e-3f);
+        mode = LodForDistance(distance);
+        while (mode > vraudio::kStereoPanning && kRenderingModeCost[mode] > budget) {
+          --mode;
+        }
+      }
+      budget -= kRenderingModeCost[mode];
+      BindSoundObject(system, &slot, mode);
+      SetVoiceVolume(system, slot, slot.params.gain);
+      continue;
+    }
+    // A handover stays within the group of the slot.
+    RenderGroup* group = system->groups[slot.group].get();
+    vraudio::ResonanceAudioApi* api = group->api.get();
+
+    // Advance a running handover by one step.
+    if (slot.fade_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      ReleaseSoundObject(group, slot.fade_id, slot.fade_mode);
+      slot.fade_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+    }
+    if (slot.next_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      api->SetSourceVolume(slot.render_id, 0.0f);
+      api->SetSourceVolume(slot.next_id, slot.params.gain);
+      slot.fade_id = slot.render_id;
+      slot.fade_mode = slot.render_mode;
+      slot.render_id = slot.next_id;
+      slot.render_mode = slot.next_mode;
+      slot.next_id = vraudio::ResonanceAudioApi::kInvalidSourceId;
+    }
+
+    int mode = slot.lod;
+    if (mode == kRenderingModeAuto) {
+      const float distance = source_table_.distance[voice_candidates_[i].slot] /
+                             std::max(slot.params.priority, 1e-3f);
+      // Keep the current mode while it lies within the hysteresis band.
+      mode = std::min(std::max(slot.render_mode, LodForDistance(distance)),
+                      LodForDistance(distance / kLodHysteresis));
+      while (mode > vraudio::kStereoPanning && kRenderingModeCost[mode] > budget) {
+        --mode;
+      }
+    }
+    budget -= kRenderingModeCost[mode];
+
+    if (mode != slot.render_mode && slot.fade_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      slot.next_id = AcquireSoundObject(group, mode);
+      slot.next_mode = mode;
+      ApplyParams(api, slot.next_id, slot.params);
+    }
+  }
+}
+
+void ResonanceWorld::RenderBlock(ResonanceAudioSystem* system, float* output) {
+  const size_t num_frames = system->frames_per_buffer;
+  const size_t buffer_size_samples = kNumOutputChannels * num_frames;
+  vraudio::ResonanceAudioApi* main_api = system->groups[0]->api.get();
+
+  std::fill(render_stats_.sources, render_stats_.sources + kNumPooledRenderingModes, 0);
+  render_stats_.soundfields = 0;
+  render_stats_.virtual_sources = 0;
+  render_stats_.silent_sources = 0;
+
+  if (idle_) {
+    if (!HasPendingWork(num_frames)) {
+      // Nothing to hear: drop the silent input and skip the graph.
+      for (int i = 0; i < kMaxSources; ++i) {
+        SourceSlot& slot = slots_[i];
+        if (slot.state.load(std::memory_order_acquire) == kSlotActive &&
+            slot.input.Skip(num_frames) > 0) {
+          render_stats_.silent_sources++;
+        }
+      }
+      std::fill(output, output + buffer_size_samples, 0.0f);
+      render_stats_.idle_time += static_cast<float>(num_frames) / system->sample_rate;
+      return;
+    }
+    Wake(system);
+  }
+
+  UpdateDistances(system);
+  UpdateLods(system, UpdateVoices(system));
+  bool audible = false;
+
+  // Sources are fed here, on the audio thread; the groups only render.
+  for (int i = 0; i < kMaxSources; ++i) {
+    SourceSlot& slot = slots_[i];
+    const int state = slot.state.load(std::memory_order_acquire);
+    if (state == kSlotRetiring) {
+      ReleaseSources(system, &slot);
+      slot.state.store(kSlotFree, std::memory_order_release);
+      continue;
+    }
+    if (state != kSlotActive) {
+      continue;
+    }
+    // Sources without pending input are not fed and cost no DSP this block.
+    const size_t available = slot.input.AvailableRead();
+    if (available == 0) {
+      continue;
+    }
+    if (slot.voice == kVoiceVirtual) {
+      // Keep the playback position without spending any DSP on the source.
+      slot.input.Skip(num_frames);
+      render_stats_.virtual_sources++;
+      continue;
+    }
+    if (available < num_frames) {
+      render_stats_.underruns++;
+    }
+    const size_t num_channels = slot.num_channels;
+    float* input = system->input_buffer.data();
+    const size_t read = slot.input.Read(input, std::min(available, num_frames));
+    if (PeakLevel(input, read * num_channels) < kSilenceThreshold) {
+      // Silence is not fed either; the source's own filters have no tail
+      // worth rendering, and the room keeps decaying from the mix.
+      render_stats_.silent_sources++;
+      continue;
+    }
+    audible = true;
+    if (slot.is_soundfield) {
+      render_stats_.soundfields++;
+    } else if (slot.render_mode >= 0 && slot.render_mode < kNumPooledRenderingModes) {
+      render_stats_.sources[slot.render_mode]++;
+    }
+    vraudio::ResonanceAudioApi* api = system->groups[slot.group]->api.get();
+    std::fill(input + read * num_channels, input + num_frames * num_channels, 0.0f);
+    // During a level of detail handover both sources get the same input.
+    const vraudio::ResonanceAudioApi::SourceId ids[] = {slot.render_id, slot.next_id,
+                                                        slot.fade_id, slot.room_id};
+    for (int j = 0; j < 4; ++j) {
+      if (ids[j] == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+        continue;
+      }
+      // The room copy lives in group 0.
+      vraudio::ResonanceAudioApi* target = j == 3 ? main_api : api;
+      if (num_channels == vraudio::kNumMonoChannels) {
+        // A mono block is already planar, which skips the strided copy of the
+        // interleaved path.
+        target->SetPlanarBuffer(ids[j], &input, num_channels, num_frames);
+      } else {
+        target->SetInterleavedBuffer(ids[j], input, num_channels, num_frames);
+      }
+    }
+  }
+
+  if (system->workers == nullptr) {
+    if (!main_api->FillInterleavedOutputBuffer(kNumOutputChannels, num_frames, output)) {
+      // No valid output was rendered, fill the output buffer with zeros.
+      CHECK(!vraudio::DoesIntegerMultiplicationOverflow<size_t>(
+          kNumOutputChannels, num_frames, buffer_size_samples));
+
+      std::fill(output, output + buffer_size_samples, 0.0f);
+    }
+  } else {
+    const int num_groups = static_cast<int>(system->groups.size());
+    system->workers->Run(&ResonanceWorld::RenderGroupJob, system, num_groups);
+    std::copy(system->groups[0]->output.begin(), system->groups[0]->output.end(), output);
+    for (int g = 1; g < num_groups; ++g) {
+      const float* group_output = system->groups[g]->output.data();
+      for (size_t i = 0; i < buffer_size_samples; ++i) {
+        output[i] += group_output[i];
+      }
+    }
+  }
+
+  // The graph goes idle once the tail of the last audible input is over and
+  // it actually rendered silence, which also covers late reverb onsets.
+  if (audible) {
+    tail_remaining_ = TailFrames(system->sample_rate);
+  } else {
+    tail_remaining_ -= std::min(tail_remaining_, num_frames);
+    idle_ = tail_remaining_ == 0 && PeakLevel(output, buffer_size_samples) < kSilenceThreshold;
+  }
+}
+
+bool ResonanceWorld::HasPendingWork(size_t num_frames) const {
+  for (int i = 0; i < kMaxSources; ++i) {
+    const SourceSlot& slot = slots_[i];
+    const int state = slot.state.load(std::memory_order_acquire);
+    if (state == kSlotRetiring) {
+      return true;
+    }
+    if (state == kSlotActive && slot.input.PeakLevel(num_frames) >= kSilenceThreshold) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ResonanceWorld::Wake(ResonanceAudioSystem* system) {
+  idle_ = false;
+  if (world_dirty_) {
+    ApplyWorldState(system);
+    world_dirty_ = false;
+  }
+  RenderGroup* main_group = system->groups[0].get();
+  for (int i = 0; i < kMaxSources; ++i) {
+    SourceSlot& slot = slots_[i];
+    // Free slots belong to the game thread, which resets |dirty| when adding.
+    if (slot.state.load(std::memory_order_acquire) != kSlotActive || !slot.dirty) {
+      continue;
+    }
+    slot.dirty = false;
+    if (slot.render_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      continue;
+    }
+    if (slot.is_soundfield) {
+      ApplyParam(main_group->api.get(), slot.render_id, ResonanceCommand::kSourceTransform,
+                 slot.params);
+      main_group->api->SetSourceVolume(slot.render_id, slot.params.gain);
+      continue;
+    }
+    vraudio::ResonanceAudioApi* api = system->groups[slot.group]->api.get();
+    ApplyParams(api, slot.render_id, slot.params);
+    if (slot.next_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      ApplyParams(api, slot.next_id, slot.params);
+    }
+    if (slot.room_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+      ApplyParams(main_group->api.get(), slot.room_id, slot.params);
+    }
+    if (slot.voice == kVoiceAudible) {
+      SetVoiceVolume(system, slot, slot.params.gain);
+    }
+  }
+}
+
+size_t ResonanceWorld::TailFrames(int sample_rate) const {
+  float rt60 = 0.0f;
+  if (room_.enabled) {
+    for (size_t i = 0; i < vraudio::kNumReverbOctaveBands; ++i) {
+      rt60 = std::max(rt60, room_.reverb.rt60_values[i]);
+    }
+  }
+  return static_cast<size_t>((kTailRt60s * rt60 + kMinTailTime) * sample_rate);
+}
+
+void ResonanceWorld::RenderGroupJob(void* context, int index) {
+  ResonanceAudioSystem* system = static_cast<ResonanceAudioSystem*>(context);
+  RenderGroup* group = system->groups[index].get();
+  if (!group->api->FillInterleavedOutputBuffer(kNumOutputChannels, system->frames_per_buffer,
+                                               group->output.data())) {
+    std::fill(group->output.begin(), group->output.end(), 0.0f);
+  }
+}
+
+void ResonanceWorld::Push(const ResonanceCommand& command) {
+  if (!commands_.Push(command)) {
+    LOG(WARNING) << "Command queue full, dropping parameter update";
+    dropped_updates_++;
+  }
+}
+
+void ResonanceWorld::PushBatch() {
+  const size_t pushed = commands_.Push(command_batch_.data(), command_batch_.size());
+  if (pushed < command_batch_.size()) {
+    LOG(WARNING) << "Command queue full, dropping " << command_batch_.size() - pushed
+                 << " parameter updates";
+    dropped_updates_ += command_batch_.size() - pushed;
+  }
+  command_batch_.clear();
+}
+
+void ResonanceWorld::Push(int type, SourceHandle handle, float v0, float v1, float v2,
+                          float v3, float v4, float v5, float v6) {
+  ResonanceCommand command;
+  command.type = type;
+  command.handle = handle;
+  command.values[0] = v0;
+  command.values[1] = v1;
+  command.values[2] = v2;
+  command.values[3] = v3;
+  command.values[4] = v4;
+  command.values[5] = v5;
+  command.values[6] = v6;
+  Push(command);
+}
+
+void ResonanceWorld::Apply(const ResonanceCommand& command) {
+  auto system_copy = system();
+  if (system_copy != nullptr) {
+    Apply(system_copy.get(), command);
+  }
+}
+
+void ResonanceWorld::ApplyPending(ResonanceAudioSystem* system) {
+  ResonanceCommand command;
+  while (commands_.Pop(&command)) {
+    Apply(system, command);
+    render_stats_.updates++;
+  }
+  while (curve_commands_.Pop(&distance_curve_)) {
+    // Only the latest curve matters.
+  }
+  bool room_changed = false;
+  while (room_commands_.Pop(&room_)) {
+    room_changed = true;
+  }
+  if (room_changed && idle_) {
+    world_dirty_ = true;
+  } else if (room_changed) {
+    // Only group 0 renders the room.
+    vraudio::ResonanceAudioApi* api = system->groups[0]->api.get();
+    api->SetReflectionProperties(room_.enabled ? room_.reflection
+                                               : system->null_reflection_properties);
+    api->SetReverbProperties(room_.enabled ? room_.reverb : system->null_reverb_properties);
+  }
+}
+
+void ResonanceWorld::ApplyWorldState(ResonanceAudioSystem* system) {
+  for (size_t i = 0; i < system->groups.size(); ++i) {
+    vraudio::ResonanceAudioApi* api = system->groups[i]->api.get();
+    api->SetMasterVolume(listener_gain_);
+    api->SetStereoSpeakerMode(stereo_speaker_mode_);
+    api->SetHeadPosition(listener_position_[0], listener_position_[1], listener_position_[2]);
+    api->SetHeadRotation(listener_rotation_[0], listener_rotation_[1], listener_rotation_[2],
+                         listener_rotation_[3]);
+    // Only group 0 renders the room, the others keep the null room.
+    const bool room = room_.enabled && i == 0;
+    api->SetReflectionProperties(room ? room_.reflection : system->null_reflection_properties);
+    api->SetReverbProperties(room ? room_.reverb : system->null_reverb_properties);
+  }
+}
+
+void ResonanceWorld::Apply(ResonanceAudioSystem* system, const ResonanceCommand& command) {
+  const float* v = command.values;
+  switch (command.type) {
+    case ResonanceCommand::kListenerGain:
+      listener_gain_ = v[0];
+      if (idle_) {
+        world_dirty_ = true;
+        return;
+      }
+      for (const auto& group : system->groups) {
+        group->api->SetMasterVolume(v[0]);
+      }
+      return;
+    case ResonanceCommand::kListenerStereoSpeakerMode:
+      stereo_speaker_mode_ = v[0] != 0.0f;
+      if (idle_) {
+        world_dirty_ = true;
+        return;
+      }
+      for (const auto& group : system->groups) {
+        group->api->SetStereoSpeakerMode(stereo_speaker_mode_);
+      }
+      return;
+    case ResonanceCommand::kListenerTransform:
+      std::copy(v, v + 3, listener_position_);
+      std::copy(v + 3, v + 7, listener_rotation_);
+      if (idle_) {
+        world_dirty_ = true;
+        return;
+      }
+      for (const auto& group : system->groups) {
+        group->api->SetHeadPosition(v[0], v[1], v[2]);
+        group->api->SetHeadRotation(v[3], v[4], v[5], v[6]);
+      }
+      return;
+    case ResonanceCommand::kMaxVoices:
+      max_voices_ = std::max(0, static_cast<int>(v[0]));
+      return;
+    case ResonanceCommand::kLodDistances:
+      std::copy(v, v + 3, lod_distances_);
+      return;
+    case ResonanceCommand::kLodBudget:
+      lod_budget_ = v[0];
+      return;
+    default:
+      break;
+  }
+
+  // Source commands.
+  if (command.handle < 0 || command.handle >= kMaxSources ||
+      slots_[command.handle].state.load(std::memory_order_acquire) != kSlotActive) {
+    return;
+  }
+  SourceSlot& slot = slots_[command.handle];
+  if (command.type == ResonanceCommand::kSourceRenderingMode) {
+    // Indexes the cost table and the pools, so it is checked here as well.
+    const int mode = static_cast<int>(v[0]);
+    if (mode >= kRenderingModeAuto && mode < kNumPooledRenderingModes) {
+      slot.lod = mode;
+    }
+    return;
+  }
+  StoreParam(&slot.params, command);
+  WriteSourceRow(command.handle);
+  if (idle_) {
+    // An idle graph renders nothing, so the update waits for Wake() rather
+    // than piling up in the task queue of ResonanceAudio.
+    slot.dirty = true;
+    return;
+  }
+  if (slot.render_id == vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    // Not picked up by the voice update yet, which applies all parameters
+    // before the source renders.
+    return;
+  }
+  if (command.type == ResonanceCommand::kSourceGain) {
+    // Virtual and fading voices stay silent until they are promoted.
+    if (slot.voice == kVoiceAudible) {
+      SetVoiceVolume(system, slot, slot.params.gain);
+    }
+    return;
+  }
+  vraudio::ResonanceAudioApi* api = system->groups[slot.group]->api.get();
+  ApplyParam(api, slot.render_id, command.type, slot.params);
+  if (slot.next_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    ApplyParam(api, slot.next_id, command.type, slot.params);
+  }
+  if (slot.room_id != vraudio::ResonanceAudioApi::kInvalidSourceId) {
+    ApplyParam(system->groups[0]->api.get(), slot.room_id, command.type, slot.params);
+  }
+}
+
+void ResonanceWorld::StoreParam(SourceParams* params, const ResonanceCommand& command) {
+  const float* v = command.values;
+  switch (command.type) {
+    case ResonanceCommand::kSourceDirectivity:
+      std::copy(v, v + 2, params->directivity);
+      break;
+    case ResonanceCommand::kSourceDistanceAttenuation:
+      params->requested_distance_attenuation = v[0];
+      if (params->distance_model == kDistanceModelNone) {
+        params->distance_attenuation = v[0];
+      }
+      break;
+    case ResonanceCommand::kSourceGain:
+      params->gain = v[0];
+      break;
+    case ResonanceCommand::kSourceListenerDirectivity:
+      std::copy(v, v + 2, params->listener_directivity);
+      break;
+    case ResonanceCommand::kSourceNearFieldEffectGain:
+      params->requested_near_field_gain = v[0];
+      if (params->distance_model == kDistanceModelNone) {
+        params->near_field_effect_gain = v[0];
+      }
+      break;
+    case ResonanceCommand::kSourceOcclusionIntensity:
+      params->occlusion = v[0];
+      break;
+    case ResonanceCommand::kSourceRoomEffectsGain:
+      params->room_effects_gain = v[0];
+      break;
+    case ResonanceCommand::kSourceSpread:
+      params->spread = v[0];
+      break;
+    case ResonanceCommand::kSourceTransform:
+      std::copy(v, v + 3, params->position);
+      std::copy(v + 3, v + 7, params->rotation);
+      break;
+    case ResonanceCommand::kSourcePriority:
+      params->priority = v[0];
+      break;
+    case ResonanceCommand::kSourceDistanceModel:
+      params->distance_model = static_cast<int>(v[0]);
+      params->min_distance = v[1];
+      params->max_distance = v[2];
+      // The next block computes both for the other models.
+      if (params->distance_model == kDistanceModelNone) {
+        params->distance_attenuation = params->requested_distance_attenuation;
+        params->near_field_effect_gain = params->requested_near_field_gain;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void ResonanceWorld::ApplyParam(vraudio::ResonanceAudioApi* api,
+                                vraudio::ResonanceAudioApi::SourceId id, int type,
+                                const SourceParams& params) {
+  switch (type) {
+    case ResonanceCommand::kSourceDirectivity:
+      api->SetSoundObjectDirectivity(id, params.directivity[0], params.directivity[1]);
+      break;
+    case ResonanceCommand::kSourceDistanceAttenuation:
+      api->SetSourceDistanceAttenuation(id, params.distance_attenuation);
+      break;
+    case ResonanceCommand::kSourceListenerDirectivity:
+      api->SetSoundObjectListenerDirectivity(id, params.listener_directivity[0],
+                                             params.listener_directivity[1]);
+      break;
+    case ResonanceCommand::kSourceNearFieldEffectGain:
+      api->SetSoundObjectNearFieldEffectGain(id, params.near_field_effect_gain);
+      break;
+    case ResonanceCommand::kSourceDistanceModel:
+      api->SetSourceDistanceAttenuation(id, params.distance_attenuation);
+      api->SetSoundObjectNearFieldEffectGain(id, params.near_field_effect_gain);
+      break;
+    case ResonanceCommand::kSourceOcclusionIntensity:
+      api->SetSoundObjectOcclusionIntensity(id, params.occlusion);
+      break;
+    case ResonanceCommand::kSourceRoomEffectsGain:
+      api->SetSourceRoomEffectsGain(id, params.room_effects_gain);
+      break;
+    case ResonanceCommand::kSourceSpread:
+      api->SetSoundObjectSpread(id, params.spread);
+      break;
+    case ResonanceCommand::kSourceTransform:
+      api->SetSourcePosition(id, params.position[0], params.position[1],
+                             params.position[2]);
+      api->SetSourceRotation(id, params.rotation[0], params.rotation[1],
+                             params.rotation[2], params.rotation[3]);
+      break;
+    default:
+      break;
+  }
+}
+
+void ResonanceWorld::ApplyParams(vraudio::ResonanceAudioApi* api,
+                                 vraudio::ResonanceAudioApi::SourceId id,
+                                 const SourceParams& params) {
+  const int types[] = {
+      ResonanceCommand::kSourceDirectivity,
+      ResonanceCommand::kSourceDistanceAttenuation,
+      ResonanceCommand::kSourceListenerDirectivity,
+      ResonanceCommand::kSourceNearFieldEffectGain,
+      ResonanceCommand::kSourceOcclusionIntensity,
+      ResonanceCommand::kSourceRoomEffectsGain,
+      ResonanceCommand::kSourceSpread,
+      ResonanceCommand::kSourceTransform,
+  };
+  for (const int type : types) {
+    ApplyParam(api, id, type, params);
+  }
+}
+
+void ResonanceWorld::SetListenerGain(float gain) {
+  Push(ResonanceCommand::kListenerGain, kInvalidSourceHandle, gain);
+}
+
+void ResonanceWorld::SetListenerStereoSpeakerMode(bool enable_stereo_speaker_mode) {
+  Push(ResonanceCommand::kListenerStereoSpeakerMode, kInvalidSourceHandle,
+       enable_stereo_speaker_mode ? 1.0f : 0.0f);
+}
+
+void ResonanceWorld::SetListenerTransform(float px, float py, float pz, float qx,
+                                          float qy, float qz, float qw) {
+  Push(ResonanceCommand::kListenerTransform, kInvalidSourceHandle, px, py, pz, qx, qy,
+       qz, qw);
+  game_listener_position_[0] = px;
+  game_listener_position_[1] = py;
+  game_listener_position_[2] = pz;
+  room_lookup_pending_ = true;
+}
+
+void ResonanceWorld::SetSourceDirectivity(SourceHandle handle, float alpha, float order) {
+  Push(ResonanceCommand::kSourceDirectivity, handle, alpha, order);
+}
+
+void ResonanceWorld::SetSourceDistanceAttenuation(SourceHandle handle,
+                                                  float distance_attenuation) {
+  Push(ResonanceCommand::kSourceDistanceAttenuation, handle, distance_attenuation);
+}
+
+void ResonanceWorld::SetSourceGain(SourceHandle handle, float gain) {
+  Push(ResonanceCommand::kSourceGain, handle, gain);
+}
+
+void ResonanceWorld::SetSourceListenerDirectivity(SourceHandle handle, float alpha,
+                                                  float order) {
+  Push(ResonanceCommand::kSourceListenerDirectivity, handle, alpha, order);
+}
+
+void ResonanceWorld::SetSourceNearFieldEffectGain(SourceHandle handle,
+                                                  float near_field_effect_gain) {
+  Push(ResonanceCommand::kSourceNearFieldEffectGain, handle, near_field_effect_gain);
+}
+
+void ResonanceWorld::SetSourceOcclusionIntensity(SourceHandle handle, float intensity) {
+  Push(ResonanceCommand::kSourceOcclusionIntensity, handle, intensity);
+}
+
+void ResonanceWorld::SetSourceRoomEffectsGain(SourceHandle handle,
+                                              float room_effects_gain) {
+  Push(ResonanceCommand::kSourceRoomEffectsGain, handle, room_effects_gain);
+}
+
+void ResonanceWorld::SetSourceSpread(SourceHandle handle, float spread_deg) {
+  Push(ResonanceCommand::kSourceSpread, handle, spread_deg);
+}
+
+void ResonanceWorld::SetSourceTransform(SourceHandle handle, float px, float py,
+                                        float pz, float qx, float qy, float qz,
+                                        float qw) {
+  Push(ResonanceCommand::kSourceTransform, handle, px, py, pz, qx, qy, qz, qw);
+  if (handle >= 0 && handle < kMaxSources) {
+    float* position = slots_[handle].position;
+    position[0] = px;
+    position[1] = py;
+    position[2] = pz;
+  }
+}
+
+void ResonanceWorld::SetSourceTransforms(const SourceHandle* handles, const float* positions,
+                                         const float* rotations, size_t count) {
+  static const float kIdentity[] = {0.0f, 0.0f, 0.0f, 1.0f};
+  for (size_t i = 0; i < count; ++i) {
+    const float* position = positions + 3 * i;
+    const float* rotation = rotations != nullptr ? rotations + 4 * i : kIdentity;
+    const SourceHandle right = handles[i] >= 0 && handles[i] < kMaxSources
+                                   ? slots_[handles[i]].stereo_right
+                                   : kInvalidSourceHandle;
+    if (right == kInvalidSourceHandle) {
+      PushTransform(handles[i], position, rotation);
+      continue;
+    }
+    // The channels sit on the local x axis, left channel towards -x.
+    const float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    const float half_width = 0.5f * slots_[handles[i]].stereo_width;
+    const float offset[] = {half_width * (1.0f - 2.0f * (y * y + z * z)),
+                            half_width * 2.0f * (x * y + w * z),
+                            half_width * 2.0f * (x * z - w * y)};
+    const float left_position[] = {position[0] - offset[0], position[1] - offset[1],
+                                   position[2] - offset[2]};
+    const float right_position[] = {position[0] + offset[0], position[1] + offset[1],
+                                    position[2] + offset[2]};
+    PushTransform(handles[i], left_position, rotation);
+    PushTransform(right, right_position, rotation);
+  }
+  PushBatch();
+}
+
+void ResonanceWorld::SetSourceGains(const SourceHandle* handles, const float* gains,
+                                    size_t count) {
+  ResonanceCommand command;
+  command.type = ResonanceCommand::kSourceGain;
+  std::fill(command.values, command.values + 7, 0.0f);
+  for (size_t i = 0; i < count; ++i) {
+    command.handle = handles[i];
+    command.values[0] = gains[i];
+    command_batch_.push_back(command);
+    if (handles[i] >= 0 && handles[i] < kMaxSources &&
+        slots_[handles[i]].stereo_right != kInvalidSourceHandle) {
+      command.handle = slots_[handles[i]].stereo_right;
+      command_batch_.push_back(command);
+    }
+  }
+  PushBatch();
+}
+
+void ResonanceWorld::PushTransform(SourceHandle handle, const float* position,
+                                   const float* rotation) {
+  ResonanceCommand command;
+  command.type = ResonanceCommand::kSourceTransform;
+  command.handle = handle;
+  std::copy(position, position + 3, command.values);
+  std::copy(rotation, rotation + 4, command.values + 3);
+  command_batch_.push_back(command);
+  if (handle >= 0 && handle < kMaxSources) {
+    std::copy(position, position + 3, slots_[handle].position);
+  }
+}
+
+void ResonanceWorld::SetSourceStereoPair(SourceHandle left, SourceHandle right, float width) {
+  if (left < 0 || left >= kMaxSources) {
+    return;
+  }
+  slots_[left].stereo_right = right;
+  slots_[left].stereo_width = width;
+}
+
+void ResonanceWorld::SetSourceOcclusionIntensities(const SourceHandle* handles,
+                                                   const float* intensities, size_t count) {
+  command_batch_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    ResonanceCommand& command = command_batch_[i];
+    command.type = ResonanceCommand::kSourceOcclusionIntensity;
+    command.handle = handles[i];
+    std::fill(command.values, command.values + 7, 0.0f);
+    command.values[0] = intensities[i];
+  }
+  PushBatch();
+}
+
+ResonanceWorld::SourceHandle ResonanceWorld::NextSoundObject(SourceHandle handle) const {
+  for (int i = std::max(handle + 1, 0); i < kMaxSources; ++i) {
+    const SourceSlot& slot = slots_[i];
+    if (slot.state.load(std::memory_order_acquire) == kSlotActive && !slot.is_soundfield) {
+      return i;
+    }
+  }
+  return kInvalidSourceHandle;
+}
+
+const float* ResonanceWorld::GetSourcePosition(SourceHandle handle) const {
+  CHECK(handle >= 0 && handle < kMaxSources);
+  return slots_[handle].position;
+}
+
+const float* ResonanceWorld::GetListenerPosition() const {
+  return game_listener_position_;
+}
+
+void ResonanceWorld::SetSourceDistanceModel(SourceHandle handle, int model,
+                                            float min_distance, float max_distance) {
+  model = std::min(std::max(model, static_cast<int>(kDistanceModelNone)),
+                   static_cast<int>(kDistanceModelCustom));
+  min_distance = std::max(min_distance, 1e-3f);
+  max_distance = std::max(max_distance, min_distance + 1e-3f);
+  Push(ResonanceCommand::kSourceDistanceModel, handle, static_cast<float>(model), min_distance,
+       max_distance);
+}
+
+void ResonanceWorld::SetDistanceCurve(const DistanceCurve& curve) {
+  if (!curve_commands_.Push(curve)) {
+    LOG(WARNING) << "Curve queue full, dropping distance curve update";
+    dropped_updates_++;
+  }
+}
+
+void ResonanceWorld::SetSourcePriority(SourceHandle handle, float priority) {
+  Push(ResonanceCommand::kSourcePriority, handle, priority);
+}
+
+void ResonanceWorld::SetMaxVoices(int max_voices) {
+  Push(ResonanceCommand::kMaxVoices, kInvalidSourceHandle, static_cast<float>(max_voices));
+}
+
+void ResonanceWorld::SetSourceRenderingMode(SourceHandle handle, int rendering_mode) {
+  if (rendering_mode < kRenderingModeAuto || rendering_mode >= kNumPooledRenderingModes) {
+    LOG(WARNING) << "Invalid rendering mode " << rendering_mode;
+    return;
+  }
+  Push(ResonanceCommand::kSourceRenderingMode, handle, static_cast<float>(rendering_mode));
+}
+
+void ResonanceWorld::SetLodDistances(float high, float medium, float low) {
+  Push(ResonanceCommand::kLodDistances, kInvalidSourceHandle, high, medium, low);
+}
+
+void ResonanceWorld::SetLodBudget(float budget) {
+  Push(ResonanceCommand::kLodBudget, kInvalidSourceHandle, budget);
+}
+
+void ResonanceWorld::SetRoomProperties(vraudio::RoomProperties* room_properties,
+                                       float* rt60s) {
+  UpdateRoomEffects(&outside_room_, room_properties, rt60s);
+  UpdateRooms();
+}
+
+ResonanceWorld::RoomHandle ResonanceWorld::AddRoom() {
+  RoomHandle handle = 0;
+  while (handle < static_cast<RoomHandle>(rooms_.size()) && rooms_[handle].active) {
+    ++handle;
+  }
+  if (handle == static_cast<RoomHandle>(rooms_.size())) {
+    rooms_.push_back(RoomEntry());
+  }
+  rooms_[handle] = RoomEntry();
+  rooms_[handle].active = true;
+  // The volume enters the index with its first SetRoom().
+  return handle;
+}
+
+void ResonanceWorld::SetRoom(RoomHandle handle, const vraudio::RoomProperties& room_properties,
+                             const float* rt60s) {
+  if (handle < 0 || handle >= static_cast<RoomHandle>(rooms_.size()) ||
+      !rooms_[handle].active) {
+    return;
+  }
+  RoomEntry& room = rooms_[handle];
+  const bool moved =
+      !room.cached ||
+      !std::equal(room_properties.position, room_properties.position + 3,
+                  room.properties.position) ||
+      !std::equal(room_properties.rotation, room_properties.rotation + 4,
+                  room.properties.rotation) ||
+      !std::equal(room_properties.dimensions, room_properties.dimensions + 3,
+                  room.properties.dimensions);
+  if (moved) {
+    room_index_.Set(handle, room_properties.position, room_properties.rotation,
+                    room_properties.dimensions);
+    room_lookup_pending_ = true;
+  }
+  UpdateRoomEffects(&room, &room_properties, rt60s);
+}
+
+void ResonanceWorld::RemoveRoom(RoomHandle handle) {
+  if (handle < 0 || handle >= static_cast<RoomHandle>(rooms_.size()) ||
+      !rooms_[handle].active) {
+    return;
+  }
+  rooms_[handle] = RoomEntry();
+  room_index_.Remove(handle);
+  room_lookup_pending_ = true;
+}
+
+bool ResonanceWorld::UpdateRooms() {
+  const auto now = std::chrono::steady_clock::now();
+  if (room_lookup_pending_) {
+    const RoomHandle room = room_index_.Find(game_listener_position_);
+    room_lookup_pending_ = false;
+    if (room != listener_room_) {
+      // Fading from what is heard right now also covers crossing into yet
+      // another room halfway through a crossfade.
+      listener_room_ = room;
+      room_fade_from_ = room_command_;
+      room_fade_start_ = now;
+      room_fade_step_ = 0;
+      room_revision_pushed_ = listener_room_ != kInvalidRoomHandle
+                                  ? rooms_[listener_room_].revision
+                                  : outside_room_.revision;
+    }
+  }
+
+  const RoomEntry& room =
+      listener_room_ != kInvalidRoomHandle ? rooms_[listener_room_] : outside_room_;
+  int step = kRoomFadeSteps;
+  if (room_fade_step_ < kRoomFadeSteps) {
+    const float elapsed = std::chrono::duration<float>(now - room_fade_start_).count();
+    step = std::min(static_cast<int>(elapsed / kRoomFadeTime * kRoomFadeSteps),
+                    kRoomFadeSteps);
+  }
+  // Quantizing the crossfade keeps the reverb from being retuned every frame.
+  if (step != room_fade_step_ || room.revision != room_revision_pushed_) {
+    const ResonanceRoomCommand command =
+        step < kRoomFadeSteps
+            ? BlendRooms(room_fade_from_, room.effects,
+                         static_cast<float>(step) / kRoomFadeSteps)
+            : room.effects;
+    if (!room_commands_.Push(command)) {
+      LOG(WARNING) << "Room command queue full, dropping room update";
+      // Push again on the next call.
+      late_updates_++;
+      return true;
+    }
+    room_command_ = command;
+    room_fade_step_ = step;
+    room_revision_pushed_ = room.revision;
+  }
+  return room_fade_step_ < kRoomFadeSteps;
+}
+
+void ResonanceWorld::UpdateRoomEffects(RoomEntry* room,
+                                       const vraudio::RoomProperties* room_properties,
+                                       const float* rt60s) {
+  ResonanceRoomCommand& effects = room->effects;
+  if (room_properties == nullptr) {
+    if (room->cached && !effects.enabled) {
+      return;
+    }
+    effects.enabled = false;
+  } else {
+    const vraudio::RoomProperties& properties = *room_properties;
+    const bool has_rt60s = rt60s != nullptr;
+    // Reflections follow the room's pose; the reverb only its size and surfaces.
+    const bool reflection_changed =
+        !room->cached || !effects.enabled || !SameRoomShape(properties, room->properties) ||
+        !std::equal(properties.position, properties.position + 3, room->properties.position) ||
+        !std::equal(properties.rotation, properties.rotation + 4, room->properties.rotation) ||
+        properties.reflection_scalar != room->properties.reflection_scalar;
+    const bool reverb_changed =
+        !room->cached || !effects.enabled || has_rt60s != room->has_rt60s ||
+        properties.reverb_gain != room->properties.reverb_gain ||
+        properties.reverb_time != room->properties.reverb_time ||
+        properties.reverb_brightness != room->properties.reverb_brightness ||
+        (has_rt60s
+             ? !std::equal(rt60s, rt60s + vraudio::kNumReverbOctaveBands, room->rt60s)
+             : !SameRoomShape(properties, room->properties));
+    if (!reflection_changed && !reverb_changed) {
+      return;
+    }
+
+    // The room effects are computed here so the audio thread only copies them.
+    if (reflection_changed) {
+      effects.reflection = ComputeReflectionProperties(properties);
+    }
+    if (reverb_changed) {
+      effects.reverb = has_rt60s ? vraudio::ComputeReverbPropertiesFromRT60s(
+                                       rt60s, properties.reverb_brightness,
+                                       properties.reverb_time, properties.reverb_gain)
+                                 : ComputeReverbProperties(properties);
+    }
+    effects.enabled = true;
+    room->properties = properties;
+    room->has_rt60s = has_rt60s;
+    if (has_rt60s) {
+      std::copy(rt60s, rt60s + vraudio::kNumReverbOctaveBands, room->rt60s);
+    }
+  }
+  room->cached = true;
+  room->revision = ++room_revision_;
+}
+
+ResonanceRoomCommand ResonanceWorld::BlendRooms(const ResonanceRoomCommand& from,
+                                                const ResonanceRoomCommand& to, float t) {
+  if (!from.enabled && !to.enabled) {
+    return to;
+  }
+  // A room without effects blends as a silent copy of the other one.
+  const ResonanceRoomCommand& a = from.enabled ? from : to;
+  const ResonanceRoomCommand& b = to.enabled ? to : from;
+  const float gain_a = from.enabled ? 1.0f : 0.0f;
+  const float gain_b = to.enabled ? 1.0f : 0.0f;
+
+  ResonanceRoomCommand blend;
+  blend.enabled = true;
+  if (t < 0.5f) {
+    blend.reflection = a.reflection;
+    blend.reflection.gain *= gain_a * (1.0f - 2.0f * t);
+  } else {
+    blend.reflection = b.reflection;
+    blend.reflection.gain *= gain_b * (2.0f * t - 1.0f);
+  }
+  for (size_t i = 0; i < vraudio::kNumReverbOctaveBands; ++i) {
+    blend.reverb.rt60_values[i] =
+        a.reverb.rt60_values[i] + t * (b.reverb.rt60_values[i] - a.reverb.rt60_values[i]);
+  }
+  blend.reverb.gain = (1.0f - t) * gain_a * a.reverb.gain + t * gain_b * b.reverb.gain;
+  return blend;
+}
+
+bool ResonanceWorld::SameRoomShape(const vraudio::RoomProperties& a,
+                                   const vraudio::RoomProperties& b) {
+  return std::equal(a.dimensions, a.dimensions + 3, b.dimensions) &&
+         std::equal(a.material_names, a.material_names + vraudio::kNumRoomSurfaces,
+                    b.material_names);
+}
@@ -0,0 +1,837 @@
+#ifndef GDRESONANCE_RESONANCE_WORLD_H
+#define GDRESONANCE_RESONANCE_WORLD_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api/resonance_audio_api.h"
+#include "platforms/common/room_properties.h"
+
+#include "audio_ring.h"
+#include "command_queue.h"
+#include "render_pool.h"
+#include "room_index.h"
+#include "source_table.h"
+#include "stats_ring.h"
+
+class ResonanceStreamer;
+
+// Sound objects of the rendering modes up to binaural high quality are pooled,
+// see RenderGroup::source_pools.
+const int kNumPooledRenderingModes = vraudio::kBinauralHighQuality + 1;
+
+// Soundfields of the ambisonic orders 1 to 3 are pooled, see
+// RenderGroup::soundfield_pools.
+const int kNumPooledAmbisonicOrders = 3;
+
+// One partition of the sources of a graph, rendered by its own ResonanceAudio
+// instance, see ResonanceWorld::SetRenderGroups(). Group 0 is the main one:
+// it renders the room effects of all groups, and the soundfields.
+struct RenderGroup {
+  RenderGroup(int sample_rate, size_t num_channels, size_t frames_per_buffer);
+
+  std::unique_ptr<vraudio::ResonanceAudioApi> api;
+
+  // Idle sound objects per rendering mode. They are created with the graph,
+  // so that sources are handed out and taken back by the audio thread without
+  // ResonanceAudio building or tearing down any source node. Capacity is
+  // reserved up front; a pool running dry falls back to creating sources.
+  std::vector<vraudio::ResonanceAudioApi::SourceId> source_pools[kNumPooledRenderingModes];
+  // Idle kRoomEffectsOnly sound objects of group 0, which feed the room with
+  // the sources of the other groups.
+  std::vector<vraudio::ResonanceAudioApi::SourceId> room_pool;
+  // Idle ambisonic sources of group 0 per order, first order first, handed
+  // out to soundfields the same way.
+  std::vector<vraudio::ResonanceAudioApi::SourceId> soundfield_pools[kNumPooledAmbisonicOrders];
+
+  // Sound objects assigned to the group. Audio thread only.
+  int num_sources;
+
+  // Block rendered by the group when the groups are mixed.
+  std::vector<float> output;
+};
+
+struct ResonanceAudioSystem {
+  ResonanceAudioSystem(int sample_rate, size_t num_channels, size_t frames_per_buffer,
+                       int num_groups);
+
+  // ResonanceAudio instances the sources are partitioned into. A single group
+  // renders straight into the output.
+  std::vector<std::unique_ptr<RenderGroup>> groups;
+  // Renders the groups in parallel; null with a single group.
+  std::unique_ptr<RenderPool> workers;
+
+  int sample_rate;
+
+  // Tells the graphs of a world apart, see ResonanceWorld::Render().
+  uint64_t generation;
+
+  // Default room properties, which effectively disable the room effects.
+  vraudio::ReflectionProperties null_reflection_properties;
+  vraudio::ReverbProperties null_reverb_properties;
+
+  // Native block size of the graph.
+  size_t frames_per_buffer;
+
+  // Scratch buffer one source block is read into before it is handed to its group.
+  std::vector<float> input_buffer;
+
+  // Block adapter between the driver and the graph, only touched by the audio
+  // thread. Blocks rendered ahead of the driver wait in |output_ring|.
+  AudioRing output_ring;
+  std::vector<float> output_buffer;
+  // Frames requested by the driver that have not been rendered yet.
+  size_t pending_frames;
+  // Set by the first driver call the graph renders, which picks the mode of
+  // the adapter for the lifetime of the graph.
+  bool started;
+  // Re-blocking mode, chosen when the first driver call is not a whole number
+  // of blocks: the adapter adds a block of latency up front and renders a
+  // block once the driver asked for all of its frames. Otherwise blocks are
+  // rendered in place, and a stray partial call renders one block ahead
+  // instead of changing the latency.
+  bool primed;
+};
+
+// Parameter update queued by the game thread and applied on the audio thread
+// at the start of the next block. |values| holds the arguments of the matching
+// ResonanceWorld setter in order.
+struct ResonanceCommand {
+  enum Type {
+    kListenerGain,
+    kListenerStereoSpeakerMode,
+    kListenerTransform,
+    kSourceDirectivity,
+    kSourceDistanceAttenuation,
+    kSourceGain,
+    kSourceListenerDirectivity,
+    kSourceNearFieldEffectGain,
+    kSourceOcclusionIntensity,
+    kSourceRoomEffectsGain,
+    kSourceSpread,
+    kSourceTransform,
+    kSourcePriority,
+    kSourceRenderingMode,
+    kSourceDistanceModel,
+    kMaxVoices,
+    kLodDistances,
+    kLodBudget,
+  };
+
+  int type;
+  int handle;
+  float values[7];
+};
+
+// Room effects computed by the game thread, applied like a ResonanceCommand.
+struct ResonanceRoomCommand {
+  bool enabled;
+  vraudio::ReflectionProperties reflection;
+  vraudio::ReverbProperties reverb;
+};
+
+// Cost of one Render() call, recorded by the audio thread.
+struct RenderStats {
+  // Seconds spent in Render() and seconds of audio it rendered.
+  float render_time;
+  float audio_time;
+  // Sound objects fed to the graph per rendering mode, and soundfields, in
+  // the last block rendered.
+  uint16_t sources[kNumPooledRenderingModes];
+  uint16_t soundfields;
+  // Sources with input that had no voice.
+  uint16_t virtual_sources;
+  // Sources whose input ran dry within a block.
+  uint16_t underruns;
+  // Parameter updates applied at the start of the call.
+  uint16_t updates;
+  // Sources with a voice whose input was silent in the last block.
+  uint16_t silent_sources;
+  // Whether the graph was idle at the end of the call.
+  uint16_t idle;
+  // Seconds of the rendered audio the graph was idle for.
+  float idle_time;
+};
+
+// Summary of the recent Render() calls of a world, see
+// ResonanceWorld::GetStats(). Times are in milliseconds.
+struct ResonanceStats {
+  // Recent calls summarized below, at most ResonanceWorld::kStatsWindow.
+  int blocks;
+  float render_time;
+  float max_render_time;
+  // Share of the rendered audio time spent rendering it.
+  float load;
+  // Parameter updates applied per call.
+  float updates;
+  // Of the latest call.
+  int sources[kNumPooledRenderingModes];
+  int soundfields;
+  int virtual_sources;
+  int silent_sources;
+  bool idle;
+  // Share of the rendered audio time the graph was idle.
+  float idle_time;
+  // Totals since the world was created: calls, calls that took longer than
+  // the audio they rendered, source underruns, parameter updates dropped on
+  // a full queue and room updates pushed a frame late for the same reason.
+  uint64_t total_blocks;
+  uint64_t late_blocks;
+  uint64_t underruns;
+  uint64_t dropped_updates;
+  uint64_t late_updates;
+  // Longest call since the world was created.
+  float peak_render_time;
+};
+
+// Registry of sound sources sharing a single ResonanceAudio graph. Each source
+// is fed through its own input ring and Render() mixes all of them with one
+// listener render per audio block.
+//
+// Sources are addressed by a slot handle rather than by ResonanceAudio source
+// id so that the underlying graph can be rebuilt without invalidating them.
+//
+// Worlds are looked up by name. Every world owns its own graph, so separate
+// worlds (buses, split-screen listeners, editor previews) render independently.
+class ResonanceWorld {
+public:
+    typedef int SourceHandle;
+    static const SourceHandle kInvalidSourceHandle = -1;
+
+    typedef int RoomHandle;
+    static const RoomHandle kInvalidRoomHandle = -1;
+
+    // Maximum number of sources registered at the same time.
+    static const int kMaxSources = 256;
+
+    // Capacity of every source input ring, in frames.
+    static const size_t kInputRingFrames = 8192;
+
+    // Duration of the room crossfade in seconds, and the number of steps it
+    // is pushed to the audio thread in.
+    static constexpr float kRoomFadeTime = 0.5f;
+    static const int kRoomFadeSteps = 8;
+
+    // Default number of sources rendered per block, see SetMaxVoices().
+    static const int kDefaultMaxVoices = 64;
+
+    // Default number of idle sound objects per rendering mode created with a
+    // graph, see SetSourcePoolSize(). Enough for every default voice to render
+    // in any one mode, which also covers the share of any LOD budget.
+    static const int kDefaultSourcePoolSize = kDefaultMaxVoices;
+
+    // Default number of idle ambisonic sources per order created with a graph,
+    // see SetSoundfieldPoolSize().
+    static const int kDefaultSoundfieldPoolSize = 2;
+
+    // Most ResonanceAudio instances a graph is split into, see
+    // SetRenderGroups().
+    static const int kMaxRenderGroups = 8;
+
+    // Render() calls summarized by GetStats().
+    static const int kStatsWindow = 256;
+
+    // Rendering mode value selecting the automatic level of detail.
+    static const int kRenderingModeAuto = -1;
+
+    // Peak level below which a block of input or output counts as silent,
+    // -100 dBFS.
+    static constexpr float kSilenceThreshold = 1e-5f;
+
+    ResonanceWorld();
+    ~ResonanceWorld();
+
+    // Returns the world registered under |name|, creating it on first use.
+    // Worlds stay alive until ReleaseAll(), so callers may keep the pointer.
+    static ResonanceWorld* Get(const std::string& name);
+
+    // Destroys all worlds. Nothing may render or hold a world afterwards.
+    static void ReleaseAll();
+
+    // Registers |renderer| as the instance driving Render(). Returns true for
+    // the first renderer, which is expected to Initialize() the graph.
+    bool AttachRenderer(const void* renderer);
+
+    // Unregisters |renderer|. Returns true when the last renderer left, which
+    // is expected to Shutdown() the graph.
+    bool DetachRenderer(const void* renderer);
+
+    // Whether |renderer| is the most recently attached renderer. Only that one
+    // renders, any other renderer of the same world only feeds its input and
+    // outputs silence.
+    bool IsRenderer(const void* renderer) const;
+
+    // Requests a ResonanceAudio graph with all registered sources. The graph
+    // is built on the world's builder thread and swapped in once complete;
+    // until then the current graph, if any, keeps rendering. The audio thread
+    // carries the source, listener and room state over to the new graph.
+    void Initialize(int sample_rate, size_t num_channels, size_t frames_per_buffer);
+
+    // Number of sound objects of |rendering_mode| that graphs create up front,
+    // so that sources of that mode are added, switched by the level of detail
+    // and removed without building source nodes while rendering. Only voiced
+    // sound objects hold a source, so a pool the size of SetMaxVoices() only
+    // runs dry during level of detail handovers. Takes effect with the next Initialize().
+    void SetSourcePoolSize(vraudio::RenderingMode rendering_mode, int size);
+    int GetSourcePoolSize(vraudio::RenderingMode rendering_mode);
+
+    // Number of ambisonic sources of every order that graphs create up front
+    // for the soundfields, likewise. Takes effect with the next Initialize().
+    void SetSoundfieldPoolSize(int size);
+    int GetSoundfieldPoolSize();
+
+    // Splits the sound objects of the graph into |count| groups, each with its
+    // own ResonanceAudio instance, rendered in parallel on worker threads and
+    // mixed. Sources are assigned to the least busy group when picked up. The
+    // room effects of all groups are rendered once, by the first group, from
+    // room-effects-only copies of the sources of the others. One group renders
+    // everything on the audio thread. Takes effect with the next Initialize().
+    void SetRenderGroups(int count);
+    int GetRenderGroups();
+
+    // Releases the ResonanceAudio graph and cancels a pending build.
+    void Shutdown();
+
+    // Sample rate of the graph last requested by Initialize(), or 0.
+    int sample_rate() const;
+
+    // Whether a graph is built and Render() renders it. Initialize() builds
+    // it in the background; offline renderers wait for it before rendering.
+    bool HasGraph() const;
+
+    // Registers a sound object source and returns its handle.
+    SourceHandle AddSource(vraudio::RenderingMode rendering_mode);
+
+    // Registers an ambiX soundfield with |num_channels| channels.
+    SourceHandle AddSoundfield(size_t num_channels);
+
+    // Unregisters the source. Its graph resources are released by the next
+    // Render() call.
+    void RemoveSource(SourceHandle handle);
+
+    // Queues the next |num_frames| interleaved input frames of the source.
+    // Returns the number of frames that fit into the input ring.
+    size_t PushInput(SourceHandle handle, const float* input, size_t num_frames);
+
+    // Number of frames PushInput() can queue for the source right now.
+    size_t GetInputSpace(SourceHandle handle) const;
+
+    // Interleaved channels of the frames PushInput() takes, or 0 for an
+    // invalid handle. Game thread only.
+    size_t GetInputChannels(SourceHandle handle) const;
+
+    // Plays decoded clips into the sources of this world.
+    ResonanceStreamer* streamer() { return streamer_.get(); }
+
+    // Renders |num_frames| frames of all registered sources into |output|.
+    // Any block size is accepted; when it does not match the native size of
+    // the graph the output is re-blocked at the cost of one native block of
+    // latency. This method must be called from the audio thread.
+    //
+    // Silent input blocks are not handed to the graph. Once no source had
+    // audible input for the tail of the room and the output decayed to
+    // silence, the graph goes idle: blocks are zero filled without any graph
+    // work and parameter updates are only recorded, until a source gets
+    // audible input again.
+    void Render(size_t num_frames, float* output);
+
+    // The setters below queue their update for the audio thread and must all
+    // be called from the same (game) thread.
+    void SetListenerGain(float gain);
+    void SetListenerStereoSpeakerMode(bool enable_stereo_speaker_mode);
+    void SetListenerTransform(float px, float py, float pz, float qx, float qy,
+                              float qz, float qw);
+
+    void SetSourceDirectivity(SourceHandle handle, float alpha, float order);
+    // Only takes effect while the distance model of the source is
+    // kDistanceModelNone.
+    void SetSourceDistanceAttenuation(SourceHandle handle, float distance_attenuation);
+    void SetSourceGain(SourceHandle handle, float gain);
+    void SetSourceListenerDirectivity(SourceHandle handle, float alpha, float order);
+    // With a distance model the gain is only applied within kNearFieldRadius
+    // of the listener.
+    void SetSourceNearFieldEffectGain(SourceHandle handle, float near_field_effect_gain);
+    void SetSourceOcclusionIntensity(SourceHandle handle, float intensity);
+    void SetSourceRoomEffectsGain(SourceHandle handle, float room_effects_gain);
+    void SetSourceSpread(SourceHandle handle, float spread_deg);
+    void SetSourceTransform(SourceHandle handle, float px, float py, float pz,
+                            float qx, float qy, float qz, float qw);
+
+    // Sets the room effects heard while the listener is outside of all rooms
+    // added with AddRoom(): those of |room_properties|, or none when it is
+    // null. |rt60s| optionally overrides the reverb with measured RT60s per
+    // octave band. Reflections and reverb are only recomputed when their
+    // inputs changed since the last call, so it is cheap to call every frame.
+    void SetRoomProperties(vraudio::RoomProperties* room_properties, float* rt60s);
+
+    // Registers a room volume. The listener hears the innermost room it is in;
+    // crossing into another room crossfades the room effects.
+    RoomHandle AddRoom();
+
+    // Places the room volume and sets its effects, with the same caching and
+    // arguments as SetRoomProperties(). The volume is the box described by the
+    // position, rotation and dimensions of |room_properties|.
+    void SetRoom(RoomHandle handle, const vraudio::RoomProperties& room_properties,
+                 const float* rt60s);
+
+    void RemoveRoom(RoomHandle handle);
+
+    // Looks up the room of the listener and advances the room crossfade.
+    // Returns true while a crossfade is in progress, in which case it has to
+    // be called again on the next frame.
+    bool UpdateRooms();
+
+    // Sets the occlusion intensity of |count| sources at once. The updates
+    // are queued together, so the audio thread picks up all of them at the
+    // start of the same block.
+    void SetSourceOcclusionIntensities(const SourceHandle* handles,
+                                       const float* intensities, size_t count);
+
+    // Bulk versions of SetSourceTransform() and SetSourceGain() for |count|
+    // sources, meant for scripts driving many sources at once. |positions|
+    // holds three floats per source and |rotations| four (x, y, z, w), or is
+    // null for the identity. The updates of one call are queued together, so
+    // the audio thread applies all of them at the start of the same block.
+    // The left source of a stereo pair moves and sets the gain of both.
+    void SetSourceTransforms(const SourceHandle* handles, const float* positions,
+                             const float* rotations, size_t count);
+    void SetSourceGains(const SourceHandle* handles, const float* gains, size_t count);
+
+    // Pairs sound object |left| with |right| as the two channels of one stereo
+    // source, |width| apart along the local x axis. Bulk updates addressed to
+    // |left| then apply to both. kInvalidSourceHandle for |right| unpairs.
+    void SetSourceStereoPair(SourceHandle left, SourceHandle right, float width);
+
+    // Returns the first active sound object following |handle|, or the first
+    // one for kInvalidSourceHandle. Returns kInvalidSourceHandle past the last.
+    SourceHandle NextSoundObject(SourceHandle handle) const;
+
+    // Positions as last set by SetSourceTransform() and SetListenerTransform().
+    const float* GetSourcePosition(SourceHandle handle) const;
+    const float* GetListenerPosition() const;
+
+    // Selects the DistanceModel the audio thread computes the distance
+    // attenuation of the source with every block, between |min_distance|,
+    // within which the source is at full gain, and |max_distance|.
+    void SetSourceDistanceModel(SourceHandle handle, int model, float min_distance,
+                                float max_distance);
+
+    // Gains of kDistanceModelCustom, shared by all sources of the world.
+    void SetDistanceCurve(const DistanceCurve& curve);
+
+    // Scales the audibility of the source when voices are picked.
+    void SetSourcePriority(SourceHandle handle, float priority);
+
+    // Limits how many sound objects are rendered per block. The most audible
+    // ones (gain, distance, occlusion and priority) get a voice; the others are
+    // virtualized: their input is consumed to keep its position, but it is not
+    // handed to the graph.
+    void SetMaxVoices(int max_voices);
+
+    // Selects the rendering mode of a sound object, or kRenderingModeAuto to
+    // let the level of detail pick it from distance, priority and budget.
+    void SetSourceRenderingMode(SourceHandle handle, int rendering_mode);
+
+    // Distances (divided by the source priority) beyond which automatic
+    // sources drop from high to medium quality binaural, from medium to low
+    // quality, and from low quality to stereo panning.
+    void SetLodDistances(float high, float medium, float low);
+
+    // Rendering cost per block that automatic sources share, in units of one
+    // high quality binaural source. The most audible sources are served first;
+    // the others step down in quality until they fit.
+    void SetLodBudget(float budget);
+
+    // Summarizes the Render() calls since the last kStatsWindow. The audio
+    // thread records every call into a lock-free ring that this drains, so it
+    // costs the audio thread nothing whether or not anyone reads. Game thread
+    // only.
+    void GetStats(ResonanceStats* stats);
+
+    // Applies |command| to the graph right away, bypassing the queue. Audio
+    // thread only.
+    void Apply(const ResonanceCommand& command);
+
+private:
+    enum SlotState { kSlotFree, kSlotActive, kSlotRetiring };
+
+    // Voices fade through ResonanceAudio's volume ramp: a demoted source is fed
+    // one more block while its volume ramps to zero, a promoted one ramps up
+    // from zero.
+    enum VoiceState { kVoiceVirtual, kVoiceAudible, kVoiceFadingOut };
+
+    // Parameters of a source as last applied on the audio thread, so that a
+    // replacement source can be set up identically.
+    struct SourceParams {
+      float position[3];
+      float rotation[4];
+      float gain;
+      float directivity[2];
+      float listener_directivity[2];
+      // Applied to the graph: with a distance model computed by
+      // UpdateDistances(), otherwise the requested values below.
+      float distance_attenuation;
+      float near_field_effect_gain;
+      float occlusion;
+      float room_effects_gain;
+      float spread;
+      float priority;
+      int distance_model;
+      float min_distance;
+      float max_distance;
+      float requested_distance_attenuation;
+      float requested_near_field_gain;
+    };
+
+    struct SourceSlot {
+      SourceSlot()
+          : state(kSlotFree),
+            rendering_mode(vraudio::kBinauralHighQuality),
+            num_channels(1),
+            is_soundfield(false),
+            stereo_right(kInvalidSourceHandle),
+            stereo_width(0.0f) {
+        position[0] = position[1] = position[2] = 0.0f;
+        ResetAudioState();
+      }
+
+      // Resets the audio thread state, before the slot is (re)activated.
+      void ResetAudioState();
+
+      // kSlotFree -> kSlotActive and kSlotActive -> kSlotRetiring happen on
+      // the game thread, kSlotRetiring -> kSlotFree on the audio thread.
+      std::atomic<int> state;
+      vraudio::RenderingMode rendering_mode;
+      size_t num_channels;
+      bool is_soundfield;
+      AudioRing input;
+      // Game thread mirror of the source position.
+      float position[3];
+      // Right channel of the stereo pair this slot is the left channel of,
+      // and the distance between them. Game thread only.
+      SourceHandle stereo_right;
+      float stereo_width;
+
+      // Audio thread state.
+      SourceParams params;
+      int voice;
+      // Source currently rendered and its rendering mode. Soundfields take
+      // theirs when the slot is picked up, sound objects while they have a
+      // voice; otherwise it is invalid.
+      vraudio::ResonanceAudioApi::SourceId render_id;
+      int render_mode;
+      // Render group of the sound object sources, and outside of group 0 the
+      // kRoomEffectsOnly copy in group 0 that feeds the room.
+      int group;
+      vraudio::ResonanceAudioApi::SourceId room_id;
+      // kRenderingModeAuto or the rendering mode asked for.
+      int lod;
+      // Level of detail handover: |next_id| is fed silently for one block so
+      // its gain settles at zero, then it crossfades with |render_id|, which
+      // is kept as |fade_id| until its volume ramp is over.
+      vraudio::ResonanceAudioApi::SourceId next_id;
+      int next_mode;
+      vraudio::ResonanceAudioApi::SourceId fade_id;
+      int fade_mode;
+      // Blocks a voiced sound object went without input in a row.
+      int starved_blocks;
+      // Parameters changed while the graph was idle, see Wake().
+      bool dirty;
+    };
+
+    struct VoiceCandidate {
+      float audibility;
+      int slot;
+    };
+
+    void Push(const ResonanceCommand& command);
+    // Queues the |command_batch_.size()| commands of |command_batch_| at once.
+    void PushBatch();
+    // Appends a transform of |handle| to |command_batch_| and mirrors its
+    // position.
+    void PushTransform(SourceHandle handle, const float* position, const float* rotation);
+    void Push(int type, SourceHandle handle, float v0, float v1 = 0.0f,
+              float v2 = 0.0f, float v3 = 0.0f, float v4 = 0.0f, float v5 = 0.0f,
+              float v6 = 0.0f);
+
+    // Drains both command queues into |system|.
+    void ApplyPending(ResonanceAudioSystem* system);
+    void Apply(ResonanceAudioSystem* system, const ResonanceCommand& command);
+
+    // Copies the parameters of slot |index| into its row of |source_table_|.
+    void WriteSourceRow(int index);
+
+    // Evaluates |source_table_| for the listener and hands the distance
+    // attenuation and near-field gains that changed to the graph.
+    void UpdateDistances(ResonanceAudioSystem* system);
+
+    // Picks the sources rendered this block, by the audibility UpdateDistances()
+    // estimated, and moves the others to virtual. Virtual sound objects hand
+    // their sources back to the pools. Leaves the voiced candidates sorted by
+    // audibility.
+    int UpdateVoices(ResonanceAudioSystem* system);
+
+    // Picks the rendering mode of the |num_voices| voiced sound objects,
+    // binds a pooled source to those that just got their voice and advances
+    // the crossfades of the others.
+    void UpdateLods(ResonanceAudioSystem* system, int num_voices);
+
+    // Rendering mode for a source at |distance| given the LOD distances.
+    int LodForDistance(float distance) const;
+
+    // Resets |params| to the parameters of a newly created source.
+    static void ResetParams(SourceParams* params);
+
+    // Mirrors |command| into |params|.
+    static void StoreParam(SourceParams* params, const ResonanceCommand& command);
+
+    // Hands the parameter |type| of |params| to source |id|. Volume is owned by
+    // the voice management and not handled here.
+    static void ApplyParam(vraudio::ResonanceAudioApi* api,
+                           vraudio::ResonanceAudioApi::SourceId id, int type,
+                           const SourceParams& params);
+
+    // Hands all of |params| to source |id|.
+    static void ApplyParams(vraudio::ResonanceAudioApi* api,
+                            vraudio::ResonanceAudioApi::SourceId id,
+                            const SourceParams& params);
+
+    // Inputs and effects of a room as last set, game thread only.
+    struct RoomEntry {
+      RoomEntry() : active(false), cached(false), has_rt60s(false), revision(0) {
+        effects.enabled = false;
+      }
+
+      bool active;
+      // Whether |effects| were computed from the fields below.
+      bool cached;
+      vraudio::RoomProperties properties;
+      // |rt60s| is only meaningful with |has_rt60s|.
+      bool has_rt60s;
+      float rt60s[vraudio::kNumReverbOctaveBands];
+      ResonanceRoomCommand effects;
+      // Changes whenever |effects| do, unique across the rooms of the world.
+      uint64_t revision;
+    };
+
+    // Updates the effects of |room| from the room properties and RT60s, see
+    // SetRoomProperties().
+    void UpdateRoomEffects(RoomEntry* room, const vraudio::RoomProperties* room_properties,
+                           const float* rt60s);
+
+    // Room effects |t| of the way from |from| to |to|. Reverbs are
+    // interpolated; reflections depend on the room geometry, so those of
+    // |from| fade out over the first half and those of |to| in over the second.
+    static ResonanceRoomCommand BlendRooms(const ResonanceRoomCommand& from,
+                                           const ResonanceRoomCommand& to, float t);
+
+    // Whether both rooms have the same dimensions and surface materials.
+    static bool SameRoomShape(const vraudio::RoomProperties& a,
+                              const vraudio::RoomProperties& b);
+
+    // Takes a sound object of |rendering_mode| for |slot| from the least busy
+    // group of |system|, plus its room copy outside of group 0, and sets them
+    // up with the parameters of the slot.
+    static void BindSoundObject(ResonanceAudioSystem* system, SourceSlot* slot,
+                                int rendering_mode);
+
+    // Returns every ResonanceAudio source backing |slot| to |system|.
+    static void ReleaseSources(ResonanceAudioSystem* system, SourceSlot* slot);
+
+    // Hands the listener and room state to a newly swapped in graph.
+    void ApplyWorldState(ResonanceAudioSystem* system);
+
+    // Builder thread: builds requested graphs and reclaims retired ones.
+    void BuilderLoop();
+    struct BuildRequest;
+    void Build(const BuildRequest& request, uint64_t build_serial);
+
+    // Queues |system| for destruction on the builder thread once the audio
+    // thread cannot hold it anymore. Requires |graph_mutex_|.
+    void Retire(std::shared_ptr<ResonanceAudioSystem> system);
+
+    // Renders exactly one native block of the graph into |output|.
+    void RenderBlock(ResonanceAudioSystem* system, float* output);
+
+    // Whether the next |num_frames| frames of any source are audible, or a
+    // source waits to be released, either of which wakes an idle graph.
+    bool HasPendingWork(size_t num_frames) const;
+
+    // Leaves the idle state, handing the graph the updates recorded meanwhile.
+    void Wake(ResonanceAudioSystem* system);
+
+    // Frames the graph keeps rendering after the last audible input block so
+    // that the room effects decay.
+    size_t TailFrames(int sample_rate) const;
+
+    // Publishes |render_stats_| of the call that took |render_time| seconds.
+    void RecordStats(float render_time);
+
+    SourceHandle AddSlot(vraudio::RenderingMode rendering_mode, size_t num_channels,
+                         bool is_soundfield);
+
+    // Creates a silent sound object with the wrapper's distance model.
+    static vraudio::ResonanceAudioApi::SourceId CreateSoundObject(
+        vraudio::ResonanceAudioApi* api, vraudio::RenderingMode rendering_mode);
+
+    // Hands out an idle sound object of |rendering_mode|. Audio thread only.
+    static vraudio::ResonanceAudioApi::SourceId AcquireSoundObject(RenderGroup* group,
+                                                                   int rendering_mode);
+
+    // Resets the parameters of sound object |id| and returns it to its pool,
+    // or destroys it when the pool is full. Audio thread only.
+    static void ReleaseSoundObject(RenderGroup* group, vraudio::ResonanceAudioApi::SourceId id,
+                                   int rendering_mode);
+
+    // Hands out an idle ambisonic source with |num_channels| channels. Audio
+    // thread only.
+    static vraudio::ResonanceAudioApi::SourceId AcquireSoundfield(RenderGroup* group,
+                                                                  size_t num_channels);
+
+    // Mutes ambisonic source |id| and returns it to its pool, or destroys it
+    // when the pool is full. Audio thread only.
+    static void ReleaseSoundfield(RenderGroup* group, vraudio::ResonanceAudioApi::SourceId id,
+                                  size_t num_channels);
+
+    // Pool of the ambisonic sources with |num_channels| channels in |group|,
+    // or null for unpooled orders.
+    static std::vector<vraudio::ResonanceAudioApi::SourceId>* SoundfieldPool(RenderGroup* group,
+                                                                           size_t num_channels);
+
+    // Pool of |rendering_mode| in |group|, or null for unpooled modes.
+    static std::vector<vraudio::ResonanceAudioApi::SourceId>* SourcePool(RenderGroup* group,
+                                                                       int rendering_mode);
+
+    // Sets the volume of the sources of |slot| that are heard: the rendered
+    // one and its room copy.
+    static void SetVoiceVolume(ResonanceAudioSystem* system, const SourceSlot& slot, float gain);
+
+    // Renders group |index| of the ResonanceAudioSystem |context| into its
+    // output. Runs on the render workers.
+    static void RenderGroupJob(void* context, int index);
+
+    std::shared_ptr<ResonanceAudioSystem> system() const;
+
+    std::shared_ptr<ResonanceAudioSystem> system_;
+    std::unique_ptr<SourceSlot[]> slots_;
+
+    // Graph builder. |graph_mutex_| guards the build request, the pool sizes,
+    // the group count and the retired graphs.
+    struct BuildRequest {
+      int sample_rate;
+      size_t num_channels;
+      size_t frames_per_buffer;
+      int pool_sizes[kNumPooledRenderingModes];
+      int soundfield_pool_size;
+      int num_groups;
+    };
+    struct RetiredSystem {
+      std::shared_ptr<ResonanceAudioSystem> system;
+      // Value of |render_epoch_| when the graph was replaced; once the epoch
+      // moved on, the render call that may have held it has returned.
+      uint64_t epoch;
+    };
+    std::mutex graph_mutex_;
+    std::condition_variable builder_wake_;
+    std::thread builder_;
+    bool builder_stop_;
+    bool build_pending_;
+    BuildRequest build_request_;
+    int pool_sizes_[kNumPooledRenderingModes];
+    int soundfield_pool_size_;
+    int num_groups_;
+    // Bumped by every Initialize() and Shutdown(); a build finishing with an
+    // older serial is stale and discarded.
+    uint64_t build_serial_;
+    uint64_t last_generation_;
+    std::vector<RetiredSystem> retired_systems_;
+    std::atomic<int> sample_rate_;
+    // Incremented by the audio thread at the start of every Render().
+    std::atomic<uint64_t> render_epoch_;
+
+    // Game thread -> audio thread parameter updates, and the batch the bulk
+    // setters fill before pushing it.
+    CommandQueue<ResonanceCommand, 4096> commands_;
+    std::vector<ResonanceCommand> command_batch_;
+    CommandQueue<ResonanceRoomCommand, 16> room_commands_;
+    CommandQueue<DistanceCurve, 4> curve_commands_;
+
+    // Room state, game thread only. |outside_room_| is the one set by
+    // SetRoomProperties(); |rooms_| are indexed by handle and |room_index_|
+    // holds the volumes of the active ones.
+    RoomEntry outside_room_;
+    std::vector<RoomEntry> rooms_;
+    RoomIndex room_index_;
+    uint64_t room_revision_;
+    // Listener position as last set by SetListenerTransform(), and whether it
+    // or the room volumes changed since the last room lookup.
+    float game_listener_position_[3];
+    bool room_lookup_pending_;
+    // Room the listener is in, or kInvalidRoomHandle for the outside room.
+    RoomHandle listener_room_;
+    // Crossfade from |room_fade_from_| to the listener's room, advanced in
+    // kRoomFadeSteps steps. |room_fade_step_| and |room_revision_pushed_| are
+    // the step and revision of the listener's room last pushed.
+    ResonanceRoomCommand room_fade_from_;
+    std::chrono::steady_clock::time_point room_fade_start_;
+    int room_fade_step_;
+    uint64_t room_revision_pushed_;
+    // Room effects last pushed to the audio thread.
+    ResonanceRoomCommand room_command_;
+
+    // Audio thread state. |rendered_generation_| is the graph the state below
+    // was applied to.
+    uint64_t rendered_generation_;
+    float listener_position_[3];
+    float listener_rotation_[4];
+    float listener_gain_;
+    bool stereo_speaker_mode_;
+    ResonanceRoomCommand room_;
+    int max_voices_;
+    std::unique_ptr<VoiceCandidate[]> voice_candidates_;
+    float lod_distances_[3];
+    float lod_budget_;
+    // Per-source distances and gains, one row per slot, and the curve of
+    // kDistanceModelCustom.
+    SourceTable source_table_;
+    DistanceCurve distance_curve_;
+    // Idle bypass: whether the graph is idle, the frames left until it may go
+    // idle, and whether the listener or room changed while it was.
+    bool idle_;
+    size_t tail_remaining_;
+    bool world_dirty_;
+
+    // Audio thread -> game thread instrumentation. |render_stats_| gathers
+    // the current Render() call before it goes into |stats_ring_|; the totals
+    // are kept outside of the ring so that records the reader missed count.
+    StatsRing<RenderStats, kStatsWindow> stats_ring_;
+    RenderStats render_stats_;
+    std::atomic<uint64_t> total_blocks_;
+    std::atomic<uint64_t> late_blocks_;
+    std::atomic<uint64_t> underruns_;
+    std::atomic<float> peak_render_time_;
+    // Game thread: update counters and the window GetStats() summarizes,
+    // |stats_window_size_| records ending before |stats_window_next_|.
+    uint64_t dropped_updates_;
+    uint64_t late_updates_;
+    std::unique_ptr<RenderStats[]> stats_window_;
+    std::unique_ptr<RenderStats[]> stats_scratch_;
+    int stats_window_next_;
+    int stats_window_size_;
+
+    // Created with the world, its worker starts with the first clip played.
+    std::unique_ptr<ResonanceStreamer> streamer_;
+
+    // Attached renderers in attach order, game thread only.
+    std::vector<const void*> renderers_;
+    std::atomic<const void*> renderer_;
+};
+
+#endif // GDRESONANCE_RESONANCE_WORLD_H
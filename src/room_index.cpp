@@ -0,0 +1,200 @@
+#include "room_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Rotates |v| by the unit quaternion |q| (x, y, z, w) into |out|.
+void Rotate(const float* q, const float* v, float* out) {
+  // t = 2 * cross(q.xyz, v); out = v + q.w * t + cross(q.xyz, t)
+  const float tx = 2.0f * (q[1] * v[2] - q[2] * v[1]);
+  const float ty = 2.0f * (q[2] * v[0] - q[0] * v[2]);
+  const float tz = 2.0f * (q[0] * v[1] - q[1] * v[0]);
+  out[0] = v[0] + q[3] * tx + (q[1] * tz - q[2] * ty);
+  out[1] = v[1] + q[3] * ty + (q[2] * tx - q[0] * tz);
+  out[2] = v[2] + q[3] * tz + (q[0] * ty - q[1] * tx);
+}
+
+}  // namespace
+
+void RoomIndex::Set(int id, const float* position, const float* rotation,
+                    const float* dimensions) {
+  if (id < 0) {
+    return;
+  }
+  if (id >= static_cast<int>(boxes_.size())) {
+    boxes_.resize(id + 1, Box());
+  }
+  Box& box = boxes_[id];
+  if (box.used) {
+    refit_ = true;
+  } else {
+    box.used = true;
+    rebuild_ = true;
+  }
+
+  const float length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] +
+                                 rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+  const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+  const float q[4] = {rotation[0] * scale, rotation[1] * scale, rotation[2] * scale,
+                      length > 0.0f ? rotation[3] * scale : 1.0f};
+  box.inverse_rotation[0] = -q[0];
+  box.inverse_rotation[1] = -q[1];
+  box.inverse_rotation[2] = -q[2];
+  box.inverse_rotation[3] = q[3];
+  for (int i = 0; i < 3; ++i) {
+    box.center[i] = position[i];
+    box.half_extents[i] = 0.5f * std::abs(dimensions[i]);
+  }
+  box.volume = box.half_extents[0] * box.half_extents[1] * box.half_extents[2];
+
+  // The world bounds span the rotated box: each axis of the room contributes
+  // its half extent times the absolute cosine to the world axis.
+  float extents[3] = {0.0f, 0.0f, 0.0f};
+  for (int axis = 0; axis < 3; ++axis) {
+    float unit[3] = {0.0f, 0.0f, 0.0f};
+    unit[axis] = box.half_extents[axis];
+    float rotated[3];
+    Rotate(q, unit, rotated);
+    for (int i = 0; i < 3; ++i) {
+      extents[i] += std::abs(rotated[i]);
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    box.min[i] = position[i] - extents[i];
+    box.max[i] = position[i] + extents[i];
+  }
+}
+
+void RoomIndex::Remove(int id) {
+  if (id < 0 || id >= static_cast<int>(boxes_.size()) || !boxes_[id].used) {
+    return;
+  }
+  boxes_[id].used = false;
+  rebuild_ = true;
+}
+
+int RoomIndex::Find(const float* point) {
+  if (rebuild_) {
+    Rebuild();
+  } else if (refit_) {
+    Refit();
+  }
+  if (nodes_.empty()) {
+    return -1;
+  }
+
+  int best = -1;
+  float best_volume = std::numeric_limits<float>::max();
+  // Median splits keep the depth logarithmic, far below the stack size.
+  int stack[64];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node& node = nodes_[stack[--top]];
+    if (point[0] < node.min[0] || point[0] > node.max[0] || point[1] < node.min[1] ||
+        point[1] > node.max[1] || point[2] < node.min[2] || point[2] > node.max[2]) {
+      continue;
+    }
+    if (node.count == 0) {
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+      continue;
+    }
+    for (int i = node.first; i < node.first + node.count; ++i) {
+      const Box& box = boxes_[order_[i]];
+      if (box.volume < best_volume && Contains(box, point)) {
+        best = order_[i];
+        best_volume = box.volume;
+      }
+    }
+  }
+  return best;
+}
+
+void RoomIndex::Rebuild() {
+  order_.clear();
+  for (int i = 0; i < static_cast<int>(boxes_.size()); ++i) {
+    if (boxes_[i].used) {
+      order_.push_back(i);
+    }
+  }
+  nodes_.clear();
+  if (!order_.empty()) {
+    BuildNode(0, static_cast<int>(order_.size()));
+  }
+  rebuild_ = false;
+  refit_ = false;
+}
+
+int RoomIndex::BuildNode(int first, int count) {
+  const int index = static_cast<int>(nodes_.size());
+  nodes_.push_back(Node());
+  Node node;
+  node.first = first;
+  node.count = count;
+  node.left = node.right = -1;
+  UpdateBounds(&node);
+  if (count > kLeafSize) {
+    // Split at the median of the box centers along the longest axis.
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+      if (node.max[i] - node.min[i] > node.max[axis] - node.min[axis]) {
+        axis = i;
+      }
+    }
+    const int half = count / 2;
+    std::nth_element(order_.begin() + first, order_.begin() + first + half,
+                     order_.begin() + first + count, [this, axis](int a, int b) {
+                       return boxes_[a].center[axis] < boxes_[b].center[axis];
+                     });
+    node.count = 0;
+    node.left = BuildNode(first, half);
+    node.right = BuildNode(first + half, count - half);
+  }
+  nodes_[index] = node;
+  return index;
+}
+
+void RoomIndex::Refit() {
+  // Children come after their parents, so a reverse pass sees them first.
+  for (int i = static_cast<int>(nodes_.size()) - 1; i >= 0; --i) {
+    UpdateBounds(&nodes_[i]);
+  }
+  refit_ = false;
+}
+
+void RoomIndex::UpdateBounds(Node* node) const {
+  for (int i = 0; i < 3; ++i) {
+    node->min[i] = std::numeric_limits<float>::max();
+    node->max[i] = -std::numeric_limits<float>::max();
+  }
+  if (node->count == 0 && node->left >= 0) {
+    const Node& left = nodes_[node->left];
+    const Node& right = nodes_[node->right];
+    for (int i = 0; i < 3; ++i) {
+      node->min[i] = std::min(left.min[i], right.min[i]);
+      node->max[i] = std::max(left.max[i], right.max[i]);
+    }
+    return;
+  }
+  for (int j = node->first; j < node->first + node->count; ++j) {
+    const Box& box = boxes_[order_[j]];
+    for (int i = 0; i < 3; ++i) {
+      node->min[i] = std::min(node->min[i], box.min[i]);
+      node->max[i] = std::max(node->max[i], box.max[i]);
+    }
+  }
+}
+
+bool RoomIndex::Contains(const Box& box, const float* point) const {
+  const float offset[3] = {point[0] - box.center[0], point[1] - box.center[1],
+                           point[2] - box.center[2]};
+  float local[3];
+  Rotate(box.inverse_rotation, offset, local);
+  return std::abs(local[0]) <= box.half_extents[0] &&
+         std::abs(local[1]) <= box.half_extents[1] &&
+         std::abs(local[2]) <= box.half_extents[2];
+}
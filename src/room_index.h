@@ -0,0 +1,64 @@
+#ifndef GDRESONANCE_ROOM_INDEX_H
+#define GDRESONANCE_ROOM_INDEX_H
+
+#include <vector>
+
+// Bounding volume hierarchy over oriented room boxes, answering which room a
+// point lies in. Rooms are addressed by caller-chosen non-negative ids.
+//
+// Adding or removing rooms rebuilds the tree on the next Find(); moving or
+// resizing them only refits the node bounds, so animated rooms stay cheap.
+class RoomIndex {
+public:
+    RoomIndex() : rebuild_(false), refit_(false) {}
+
+    // Places room |id| centered on |position|, rotated by the quaternion
+    // |rotation| (x, y, z, w), with the full extents |dimensions|.
+    void Set(int id, const float* position, const float* rotation, const float* dimensions);
+
+    void Remove(int id);
+
+    // Returns the innermost room containing |point|, that is the smallest one
+    // when rooms are nested, or -1 when the point is outside of all rooms.
+    int Find(const float* point);
+
+private:
+    struct Box {
+      bool used;
+      float center[3];
+      // Rotation from world into room space.
+      float inverse_rotation[4];
+      float half_extents[3];
+      float volume;
+      // World space bounds.
+      float min[3];
+      float max[3];
+    };
+
+    // Children follow their parent in |nodes_|. A leaf references |count|
+    // entries of |order_| starting at |first|; inner nodes have count 0.
+    struct Node {
+      float min[3];
+      float max[3];
+      int left;
+      int right;
+      int first;
+      int count;
+    };
+
+    static const int kLeafSize = 4;
+
+    void Rebuild();
+    int BuildNode(int first, int count);
+    void Refit();
+    void UpdateBounds(Node* node) const;
+    bool Contains(const Box& box, const float* point) const;
+
+    std::vector<Box> boxes_;
+    std::vector<int> order_;
+    std::vector<Node> nodes_;
+    bool rebuild_;
+    bool refit_;
+};
+
+#endif // GDRESONANCE_ROOM_INDEX_H
@@ -0,0 +1,224 @@
+#include "source_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GDRESONANCE_SOURCE_TABLE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Rows are processed four at a time, the width of SSE2 and NEON.
+const size_t kRowAlignment = 4;
+
+// Below this distance the listener and the source coincide.
+const float kMinDistance = 1e-6f;
+
+// Interpolates the curve at |t|, 0 at the first point and 1 at the last.
+float SampleCurve(const DistanceCurve& curve, float t) {
+  const float position = t * (DistanceCurve::kNumPoints - 1);
+  const size_t index = std::min(static_cast<size_t>(position), DistanceCurve::kNumPoints - 2);
+  const float fraction = position - static_cast<float>(index);
+  return curve.gains[index] + fraction * (curve.gains[index + 1] - curve.gains[index]);
+}
+
+}  // namespace
+
+SourceTable::SourceTable(size_t rows)
+    : num_rows((rows + kRowAlignment - 1) / kRowAlignment * kRowAlignment),
+      x(num_rows, 0.0f),
+      y(num_rows, 0.0f),
+      z(num_rows, 0.0f),
+      forward_x(num_rows, 0.0f),
+      forward_y(num_rows, 0.0f),
+      forward_z(num_rows, -1.0f),
+      directivity_alpha(num_rows, 0.0f),
+      directivity_order(num_rows, 0.0f),
+      gain(num_rows, 0.0f),
+      priority(num_rows, 0.0f),
+      occlusion(num_rows, 0.0f),
+      model(num_rows, kDistanceModelNone),
+      min_distance(num_rows, 1.0f),
+      max_distance(num_rows, 2.0f),
+      near_field_gain(num_rows, 0.0f),
+      distance(num_rows, 0.0f),
+      direction_x(num_rows, 0.0f),
+      direction_y(num_rows, 0.0f),
+      direction_z(num_rows, 0.0f),
+      attenuation(num_rows, 1.0f),
+      near_field(num_rows, 0.0f),
+      audibility(num_rows, 0.0f) {}
+
+void UpdateSourceTable(SourceTable* table, const float* listener, const DistanceCurve& curve) {
+  const size_t num_rows = table->num_rows;
+  size_t i = 0;
+#if defined(GDRESONANCE_SOURCE_TABLE_SSE2)
+  const __m128 lx = _mm_set1_ps(listener[0]);
+  const __m128 ly = _mm_set1_ps(listener[1]);
+  const __m128 lz = _mm_set1_ps(listener[2]);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 min_distance = _mm_set1_ps(kMinDistance);
+  const __m128 near_field_radius = _mm_set1_ps(kNearFieldRadius);
+  const __m128i logarithmic = _mm_set1_epi32(kDistanceModelLogarithmic);
+  const __m128i linear = _mm_set1_epi32(kDistanceModelLinear);
+  const __m128i custom = _mm_set1_epi32(kDistanceModelCustom);
+  const __m128i none = _mm_set1_epi32(kDistanceModelNone);
+  // (mask & a) | (~mask & b), SSE2 has no blend.
+  auto select = [](__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  };
+  for (; i + 4 <= num_rows; i += 4) {
+    const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&table->x[i]), lx);
+    const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&table->y[i]), ly);
+    const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&table->z[i]), lz);
+    const __m128 distance = _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+    const __m128 inverse = _mm_and_ps(_mm_cmpgt_ps(distance, min_distance),
+                                      _mm_div_ps(one, _mm_max_ps(distance, min_distance)));
+    _mm_storeu_ps(&table->distance[i], distance);
+    _mm_storeu_ps(&table->direction_x[i], _mm_mul_ps(dx, inverse));
+    _mm_storeu_ps(&table->direction_y[i], _mm_mul_ps(dy, inverse));
+    _mm_storeu_ps(&table->direction_z[i], _mm_mul_ps(dz, inverse));
+
+    const __m128 lo = _mm_loadu_ps(&table->min_distance[i]);
+    const __m128 hi = _mm_loadu_ps(&table->max_distance[i]);
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(distance, lo), hi);
+    const __m128 t = _mm_div_ps(_mm_sub_ps(clamped, lo), _mm_sub_ps(hi, lo));
+    const __m128 floor = _mm_div_ps(lo, hi);
+    const __m128 inverse_law = _mm_div_ps(_mm_sub_ps(_mm_div_ps(lo, clamped), floor),
+                                          _mm_sub_ps(one, floor));
+    const __m128i model = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&table->model[i]));
+    // Custom rows carry |t| to the curve lookup below.
+    __m128 attenuation = select(_mm_castsi128_ps(_mm_cmpeq_epi32(model, custom)), t, one);
+    attenuation = select(_mm_castsi128_ps(_mm_cmpeq_epi32(model, linear)),
+                         _mm_sub_ps(one, t), attenuation);
+    attenuation = select(_mm_castsi128_ps(_mm_cmpeq_epi32(model, logarithmic)), inverse_law,
+                         attenuation);
+    _mm_storeu_ps(&table->attenuation[i], attenuation);
+    _mm_storeu_ps(&table->near_field[i],
+                  _mm_and_ps(_mm_cmplt_ps(distance, near_field_radius),
+                             _mm_loadu_ps(&table->near_field_gain[i])));
+
+    // Without a model the voice management assumes the inverse distance law
+    // with a 1m reference distance.
+    const __m128 estimate = select(_mm_castsi128_ps(_mm_cmpeq_epi32(model, none)),
+                                   _mm_div_ps(one, _mm_max_ps(distance, one)), attenuation);
+    const __m128 loudness = _mm_mul_ps(
+        _mm_mul_ps(_mm_loadu_ps(&table->priority[i]), _mm_loadu_ps(&table->gain[i])), estimate);
+    _mm_storeu_ps(&table->audibility[i],
+                  _mm_div_ps(loudness, _mm_add_ps(one, _mm_loadu_ps(&table->occlusion[i]))));
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t lx = vdupq_n_f32(listener[0]);
+  const float32x4_t ly = vdupq_n_f32(listener[1]);
+  const float32x4_t lz = vdupq_n_f32(listener[2]);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t min_distance = vdupq_n_f32(kMinDistance);
+  const float32x4_t near_field_radius = vdupq_n_f32(kNearFieldRadius);
+  for (; i + 4 <= num_rows; i += 4) {
+    const float32x4_t dx = vsubq_f32(vld1q_f32(&table->x[i]), lx);
+    const float32x4_t dy = vsubq_f32(vld1q_f32(&table->y[i]), ly);
+    const float32x4_t dz = vsubq_f32(vld1q_f32(&table->z[i]), lz);
+    const float32x4_t distance =
+        vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+    const float32x4_t inverse = vreinterpretq_f32_u32(
+        vandq_u32(vcgtq_f32(distance, min_distance),
+                  vreinterpretq_u32_f32(vdivq_f32(one, vmaxq_f32(distance, min_distance)))));
+    vst1q_f32(&table->distance[i], distance);
+    vst1q_f32(&table->direction_x[i], vmulq_f32(dx, inverse));
+    vst1q_f32(&table->direction_y[i], vmulq_f32(dy, inverse));
+    vst1q_f32(&table->direction_z[i], vmulq_f32(dz, inverse));
+
+    const float32x4_t lo = vld1q_f32(&table->min_distance[i]);
+    const float32x4_t hi = vld1q_f32(&table->max_distance[i]);
+    const float32x4_t clamped = vminq_f32(vmaxq_f32(distance, lo), hi);
+    const float32x4_t t = vdivq_f32(vsubq_f32(clamped, lo), vsubq_f32(hi, lo));
+    const float32x4_t floor = vdivq_f32(lo, hi);
+    const float32x4_t inverse_law =
+        vdivq_f32(vsubq_f32(vdivq_f32(lo, clamped), floor), vsubq_f32(one, floor));
+    const int32x4_t model = vld1q_s32(&table->model[i]);
+    float32x4_t attenuation =
+        vbslq_f32(vceqq_s32(model, vdupq_n_s32(kDistanceModelCustom)), t, one);
+    attenuation = vbslq_f32(vceqq_s32(model, vdupq_n_s32(kDistanceModelLinear)),
+                            vsubq_f32(one, t), attenuation);
+    attenuation = vbslq_f32(vceqq_s32(model, vdupq_n_s32(kDistanceModelLogarithmic)),
+                            inverse_law, attenuation);
+    vst1q_f32(&table->attenuation[i], attenuation);
+    vst1q_f32(&table->near_field[i],
+              vreinterpretq_f32_u32(vandq_u32(
+                  vcltq_f32(distance, near_field_radius),
+                  vreinterpretq_u32_f32(vld1q_f32(&table->near_field_gain[i])))));
+
+    const float32x4_t estimate =
+        vbslq_f32(vceqq_s32(model, vdupq_n_s32(kDistanceModelNone)),
+                  vdivq_f32(one, vmaxq_f32(distance, one)), attenuation);
+    const float32x4_t loudness = vmulq_f32(
+        vmulq_f32(vld1q_f32(&table->priority[i]), vld1q_f32(&table->gain[i])), estimate);
+    vst1q_f32(&table->audibility[i],
+              vdivq_f32(loudness, vaddq_f32(one, vld1q_f32(&table->occlusion[i]))));
+  }
+#endif
+  for (; i < num_rows; ++i) {
+    const float dx = table->x[i] - listener[0];
+    const float dy = table->y[i] - listener[1];
+    const float dz = table->z[i] - listener[2];
+    const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    const float inverse = distance > kMinDistance ? 1.0f / distance : 0.0f;
+    table->distance[i] = distance;
+    table->direction_x[i] = dx * inverse;
+    table->direction_y[i] = dy * inverse;
+    table->direction_z[i] = dz * inverse;
+
+    const float lo = table->min_distance[i];
+    const float hi = table->max_distance[i];
+    const float clamped = std::min(std::max(distance, lo), hi);
+    const float t = (clamped - lo) / (hi - lo);
+    const float floor = lo / hi;
+    float attenuation = 1.0f;
+    switch (table->model[i]) {
+      case kDistanceModelLogarithmic:
+        attenuation = (lo / clamped - floor) / (1.0f - floor);
+        break;
+      case kDistanceModelLinear:
+        attenuation = 1.0f - t;
+        break;
+      case kDistanceModelCustom:
+        attenuation = t;
+        break;
+      default:
+        break;
+    }
+    table->attenuation[i] = attenuation;
+    table->near_field[i] = distance < kNearFieldRadius ? table->near_field_gain[i] : 0.0f;
+    const float estimate = table->model[i] == kDistanceModelNone
+                               ? 1.0f / std::max(distance, 1.0f)
+                               : attenuation;
+    table->audibility[i] =
+        table->priority[i] * table->gain[i] * estimate / (1.0f + table->occlusion[i]);
+  }
+
+  // The few rows with a custom curve or a directivity pattern are finished in
+  // scalar code: both need a lookup or a power per row.
+  for (i = 0; i < num_rows; ++i) {
+    float audibility = table->audibility[i];
+    if (table->model[i] == kDistanceModelCustom) {
+      const float attenuation = SampleCurve(curve, table->attenuation[i]);
+      table->attenuation[i] = attenuation;
+      audibility = table->priority[i] * table->gain[i] * attenuation / (1.0f + table->occlusion[i]);
+    }
+    const float alpha = table->directivity_alpha[i];
+    if (alpha > 0.0f) {
+      // The source faces the listener when |forward| points against the
+      // listener to source direction.
+      const float cosine = -(table->forward_x[i] * table->direction_x[i] +
+                             table->forward_y[i] * table->direction_y[i] +
+                             table->forward_z[i] * table->direction_z[i]);
+      audibility *= std::pow(std::fabs(1.0f - alpha + alpha * cosine), table->directivity_order[i]);
+    }
+    table->audibility[i] = audibility;
+  }
+}
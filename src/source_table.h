@@ -0,0 +1,78 @@
+#ifndef GDRESONANCE_SOURCE_TABLE_H
+#define GDRESONANCE_SOURCE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Distance attenuation curves computed by UpdateSourceTable(). Sound objects
+// are created without ResonanceAudio's own rolloff, so one of these, or the
+// attenuation set by hand, is all the distance attenuation they get.
+enum DistanceModel {
+  // Leaves the attenuation to ResonanceWorld::SetSourceDistanceAttenuation().
+  kDistanceModelNone,
+  // Inverse distance law from min_distance on, offset to reach silence at
+  // max_distance.
+  kDistanceModelLogarithmic,
+  // Falls linearly from 1 at min_distance to 0 at max_distance.
+  kDistanceModelLinear,
+  // Follows the DistanceCurve of the world from min_distance to max_distance.
+  kDistanceModelCustom,
+};
+
+// Distance within which ResonanceAudio's near-field effect applies.
+const float kNearFieldRadius = 1.0f;
+
+// Gains of kDistanceModelCustom at evenly spaced points from min_distance
+// (first) to max_distance (last), linearly interpolated in between.
+struct DistanceCurve {
+  static const size_t kNumPoints = 64;
+  float gains[kNumPoints];
+};
+
+// Structure-of-arrays copy of the source state the audio thread evaluates
+// every block, one row per source slot. Rows are padded to the vector width
+// so that UpdateSourceTable() handles all of them in one vectorized pass
+// instead of one scalar call per source.
+struct SourceTable {
+  explicit SourceTable(size_t num_rows);
+
+  size_t num_rows;
+
+  // Inputs, written whenever the parameters of a source change.
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  // Unit vector the source faces, for its directivity.
+  std::vector<float> forward_x;
+  std::vector<float> forward_y;
+  std::vector<float> forward_z;
+  std::vector<float> directivity_alpha;
+  std::vector<float> directivity_order;
+  std::vector<float> gain;
+  std::vector<float> priority;
+  std::vector<float> occlusion;
+  std::vector<int32_t> model;
+  std::vector<float> min_distance;
+  std::vector<float> max_distance;
+  // Near-field effect gain asked for, applied within kNearFieldRadius.
+  std::vector<float> near_field_gain;
+
+  // Outputs. |direction_*| is the unit vector from the listener to the
+  // source, zero where they coincide. |attenuation| is only meaningful with a
+  // distance model. |audibility| estimates the loudness at the listener for
+  // the voice management.
+  std::vector<float> distance;
+  std::vector<float> direction_x;
+  std::vector<float> direction_y;
+  std::vector<float> direction_z;
+  std::vector<float> attenuation;
+  std::vector<float> near_field;
+  std::vector<float> audibility;
+};
+
+// Evaluates the distance, direction, distance attenuation, near-field gain
+// and audibility of every row of |table| for a listener at |listener|.
+void UpdateSourceTable(SourceTable* table, const float* listener, const DistanceCurve& curve);
+
+#endif // GDRESONANCE_SOURCE_TABLE_H
@@ -0,0 +1,91 @@
+#ifndef GDRESONANCE_STATS_RING_H
+#define GDRESONANCE_STATS_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Fixed-capacity ring holding the latest records of a single writer. Unlike
+// CommandQueue the writer never waits for the reader: it overwrites the oldest
+// record, so an idle reader costs nothing and sees recent records once it
+// reads again. Every slot is a seqlock over atomic words, which keeps both
+// sides wait-free and allocation free without tearing a record.
+template <typename T, size_t kCapacity>
+class StatsRing {
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "Records must be trivially copyable");
+    static_assert(sizeof(T) % sizeof(uint32_t) == 0, "Records must be made of 32 bit words");
+
+public:
+    StatsRing() : written_(0), read_(0) {
+      for (Slot& slot : slots_) {
+        slot.sequence.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    // Writer side.
+    void Write(const T& record) {
+      const uint64_t index = written_.load(std::memory_order_relaxed);
+      Slot& slot = slots_[index & (kCapacity - 1)];
+      uint32_t words[kWords];
+      std::memcpy(words, &record, sizeof(T));
+      // Odd while the slot is written.
+      slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < kWords; ++i) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+      }
+      slot.sequence.store(2 * index + 2, std::memory_order_release);
+      written_.store(index + 1, std::memory_order_release);
+    }
+
+    // Reader side. Copies the records written since the last call, oldest
+    // first, into |records| and returns their number. Records that were
+    // overwritten before they could be read are skipped.
+    size_t Read(T* records, size_t max_records) {
+      const uint64_t written = written_.load(std::memory_order_acquire);
+      uint64_t index = read_;
+      if (written - index > kCapacity) {
+        index = written - kCapacity;
+      }
+      if (written - index > max_records) {
+        index = written - max_records;
+      }
+      size_t count = 0;
+      for (; index < written; ++index) {
+        const Slot& slot = slots_[index & (kCapacity - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+          continue;
+        }
+        uint32_t words[kWords];
+        for (size_t i = 0; i < kWords; ++i) {
+          words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+          continue;
+        }
+        std::memcpy(&records[count++], words, sizeof(T));
+      }
+      read_ = written;
+      return count;
+    }
+
+private:
+    static const size_t kWords = sizeof(T) / sizeof(uint32_t);
+
+    struct Slot {
+      std::atomic<uint64_t> sequence;
+      std::atomic<uint32_t> words[kWords];
+    };
+
+    alignas(64) std::atomic<uint64_t> written_;
+    // Reader state.
+    alignas(64) uint64_t read_;
+    Slot slots_[kCapacity];
+};
+
+#endif // GDRESONANCE_STATS_RING_H
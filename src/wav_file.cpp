@@ -0,0 +1,155 @@
+#include "wav_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t ReadU16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+void WriteU16(uint16_t value, uint8_t* data) {
+  data[0] = static_cast<uint8_t>(value);
+  data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void WriteU32(uint32_t value, uint8_t* data) {
+  for (int i = 0; i < 4; ++i) {
+    data[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint32_t ReadU32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// Converts one little-endian sample of |bytes| bytes to float.
+float ReadSample(const uint8_t* data, size_t bytes, bool is_float) {
+  if (is_float) {
+    const uint32_t bits = ReadU32(data);
+    float sample;
+    std::memcpy(&sample, &bits, sizeof(sample));
+    return sample;
+  }
+  switch (bytes) {
+    case 1:
+      // 8 bit PCM is unsigned.
+      return (static_cast<int>(data[0]) - 128) / 128.0f;
+    case 2:
+      return static_cast<int16_t>(ReadU16(data)) / 32768.0f;
+    case 3: {
+      // Sign-extend through the top byte of a 32 bit word.
+      const int32_t sample = static_cast<int32_t>(
+          (static_cast<uint32_t>(data[0]) << 8) | (static_cast<uint32_t>(data[1]) << 16) |
+          (static_cast<uint32_t>(data[2]) << 24));
+      return (sample >> 8) / 8388608.0f;
+    }
+    default:
+      return static_cast<int32_t>(ReadU32(data)) / 2147483648.0f;
+  }
+}
+
+}  // namespace
+
+bool ReadWav(const uint8_t* data, size_t size, StreamClip* clip) {
+  if (data == nullptr || size < 12 || std::memcmp(data, "RIFF", 4) != 0 ||
+      std::memcmp(data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  uint16_t format = 0;
+  size_t num_channels = 0;
+  int sample_rate = 0;
+  size_t block_align = 0;
+  size_t bits = 0;
+  const uint8_t* samples = nullptr;
+  size_t samples_size = 0;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    const uint8_t* chunk = data + offset;
+    const size_t chunk_size = std::min<size_t>(ReadU32(chunk + 4), size - offset - 8);
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+      format = ReadU16(chunk + 8);
+      num_channels = ReadU16(chunk + 10);
+      sample_rate = static_cast<int>(ReadU32(chunk + 12));
+      block_align = ReadU16(chunk + 20);
+      bits = ReadU16(chunk + 22);
+      if (format == kFormatExtensible && chunk_size >= 40) {
+        // The sub-format GUID starts with the actual format tag.
+        format = ReadU16(chunk + 32);
+      }
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      samples = chunk + 8;
+      samples_size = chunk_size;
+    }
+    // Chunks are padded to an even size.
+    offset += 8 + chunk_size + (chunk_size & 1);
+  }
+
+  const bool is_float = format == kFormatFloat;
+  const size_t sample_bytes = bits / 8;
+  if ((format != kFormatPcm && !is_float) || (is_float && bits != 32) ||
+      (!is_float && (bits < 8 || bits > 32 || bits % 8 != 0)) || num_channels == 0 ||
+      sample_rate <= 0 || block_align < num_channels * sample_bytes || samples == nullptr) {
+    return false;
+  }
+
+  clip->num_channels = num_channels;
+  clip->num_frames = samples_size / block_align;
+  clip->sample_rate = sample_rate;
+  clip->loop = false;
+  clip->loop_begin = 0;
+  clip->loop_end = clip->num_frames;
+  clip->samples.resize(clip->num_frames * num_channels);
+  float* out = clip->samples.data();
+  for (size_t frame = 0; frame < clip->num_frames; ++frame) {
+    const uint8_t* in = samples + frame * block_align;
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      *out++ = ReadSample(in + channel * sample_bytes, sample_bytes, is_float);
+    }
+  }
+  return clip->num_frames > 0;
+}
+
+bool WriteWav(const char* path, const float* samples, size_t num_channels, size_t num_frames,
+              int sample_rate) {
+  const size_t num_samples = num_channels * num_frames;
+  const uint32_t data_size = static_cast<uint32_t>(num_samples * sizeof(float));
+  const uint16_t block_align = static_cast<uint16_t>(num_channels * sizeof(float));
+  uint8_t header[44];
+  std::memcpy(header, "RIFF", 4);
+  WriteU32(36 + data_size, header + 4);
+  std::memcpy(header + 8, "WAVEfmt ", 8);
+  WriteU32(16, header + 16);
+  WriteU16(kFormatFloat, header + 20);
+  WriteU16(static_cast<uint16_t>(num_channels), header + 22);
+  WriteU32(static_cast<uint32_t>(sample_rate), header + 24);
+  WriteU32(static_cast<uint32_t>(sample_rate) * block_align, header + 28);
+  WriteU16(block_align, header + 32);
+  WriteU16(32, header + 34);
+  std::memcpy(header + 36, "data", 4);
+  WriteU32(data_size, header + 40);
+
+  FILE* file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = std::fwrite(header, sizeof(header), 1, file) == 1;
+  // Samples are stored little-endian whatever the host order.
+  std::vector<uint8_t> bytes(num_samples * sizeof(float));
+  for (size_t i = 0; i < num_samples; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, samples + i, sizeof(bits));
+    WriteU32(bits, bytes.data() + i * sizeof(float));
+  }
+  ok = ok && (bytes.empty() || std::fwrite(bytes.data(), bytes.size(), 1, file) == 1);
+  return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,21 @@
+#ifndef GDRESONANCE_WAV_FILE_H
+#define GDRESONANCE_WAV_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "resonance_streamer.h"
+
+// Reads and writes RIFF WAVE files without going through Godot.
+
+// Decodes a RIFF WAVE file of any channel count into |clip|. Integer PCM of 8
+// to 32 bits and 32 bit float are read, plain or as WAVE_FORMAT_EXTENSIBLE.
+// The clip does not loop. Returns false when the data is not such a file.
+bool ReadWav(const uint8_t* data, size_t size, StreamClip* clip);
+
+// Writes |num_frames| interleaved frames to |path| as a 32 bit float WAVE
+// file. Returns false when the file cannot be written.
+bool WriteWav(const char* path, const float* samples, size_t num_channels, size_t num_frames,
+              int sample_rate);
+
+#endif // GDRESONANCE_WAV_FILE_H